@@ -0,0 +1,74 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+#include "trace.hpp"
+
+/*
+*	BoundedQueue
+*
+*	Blocking multi producer, multi consumer queue holding at most capacity items. push
+*	waits while the queue is full, which is what gives pipelines their backpressure.
+*
+*	close() wakes every waiter; pop then drains the remaining items and returns false
+*	once the queue is empty. Waits show as "wait" spans in the trace.
+*/
+template <class T>
+class BoundedQueue {
+	private:
+		std::mutex lock;
+		std::condition_variable notFull;
+		std::condition_variable notEmpty;
+		std::deque<T> items;
+		size_t capacity;
+		bool closed;
+
+		//hide copy
+		BoundedQueue(const BoundedQueue&);
+		BoundedQueue& operator=(const BoundedQueue&);
+
+	public:
+		BoundedQueue(size_t capacity) : capacity(capacity < 1 ? 1 : capacity), closed(false) { }
+
+		//returns false if the queue was closed
+		bool push(T item) {
+			std::unique_lock<std::mutex> guard(lock);
+			if (!closed && items.size() >= capacity) {
+				Trace::Scope scope("wait", "queue full");
+				notFull.wait(guard, [this] { return closed || items.size() < capacity; });
+			}
+			if (closed) {
+				return false;
+			}
+
+			items.push_back(item);
+			notEmpty.notify_one();
+			return true;
+		} //push
+
+		//returns false once the queue is closed and empty
+		bool pop(T& item) {
+			std::unique_lock<std::mutex> guard(lock);
+			if (!closed && items.empty()) {
+				Trace::Scope scope("wait", "queue empty");
+				notEmpty.wait(guard, [this] { return closed || !items.empty(); });
+			}
+			if (items.empty()) {
+				return false;
+			}
+
+			item = items.front();
+			items.pop_front();
+			notFull.notify_one();
+			return true;
+		} //pop
+
+		void close() {
+			std::lock_guard<std::mutex> guard(lock);
+			closed = true;
+			notFull.notify_all();
+			notEmpty.notify_all();
+		} //close
+}; //BoundedQueue
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <list>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <ctime>
+
+#include "hash.hpp"
+#include "io helper.hpp"
+#include "filesystem.hpp"
+
+/*
+*	ContentStore
+*
+*	Process wide store of immutable buffers keyed by the hash of their contents, shared
+*	by every script of a batch. Derived values (token streams, expanded libraries) are
+*	stored under keys made from the key of their input and the name of the step, so a
+*	library shared by many map variants is read and processed once.
+*
+*	The least recently used buffers are dropped once the total size passes the limit.
+*	Buffers handed out stay valid while referenced, even after being dropped.
+*
+*	load stats the file on every call, bypassing the stat cache, since files are written
+*	during the run. Stats only have whole seconds, so a file modified in the second it
+*	was read is read again next time, as it may have changed after the read.
+*/
+class ContentStore {
+	public:
+		typedef std::shared_ptr<const std::string> Buffer;
+
+	private:
+		struct Item {
+			Buffer buffer;
+			std::list<std::string>::iterator use;
+		};
+
+		struct Loaded {
+			int64_t mtime;
+			uint64_t size;
+			int64_t read;	//when the file was read, seconds since the epoch
+			std::string key;
+		};
+
+		std::mutex lock;
+		std::unordered_map<std::string, Item> items;
+		std::unordered_map<std::string, Loaded> files;
+		std::list<std::string> uses;	//most recent first
+		size_t bytes;
+		size_t limit;
+
+		size_t hits;
+		size_t misses;
+
+		void trim() {
+			while (bytes > limit && uses.size() > 1) {
+				auto item = items.find(uses.back());
+				bytes -= item->second.buffer->size();
+				items.erase(item);
+				uses.pop_back();
+			}
+		} //trim
+
+	public:
+		ContentStore(size_t limit = 512 << 20) : bytes(0), limit(limit), hits(0), misses(0) { }
+
+		static ContentStore& shared() {
+			static ContentStore store;
+			return store;
+		} //shared
+
+		void setLimit(size_t value) {
+			std::lock_guard<std::mutex> guard(lock);
+			limit = value;
+			trim();
+		} //setLimit
+
+		//key for a step applied to inputs, e.g. derive({ sourceKey, defines }, "expand")
+		static std::string derive(const std::vector<std::string>& inputs, const std::string& step) {
+			Hash128 hash(1);
+			for (auto& input : inputs) {
+				uint64_t size = input.size();
+				hash.update(&size, sizeof(size));
+				hash.update(input);
+			}
+			hash.update(step);
+			return hash.hex();
+		} //derive
+
+		//stores value under key, or under the hash of its contents when key is empty
+		std::string put(std::string value, std::string key = std::string()) {
+			if (key.empty()) {
+				key = Hash128::of(value);
+			}
+
+			Buffer buffer = std::make_shared<const std::string>(std::move(value));
+
+			std::lock_guard<std::mutex> guard(lock);
+			auto found = items.find(key);
+			if (found != items.end()) {
+				uses.splice(uses.begin(), uses, found->second.use);
+				return key;
+			}
+
+			uses.push_front(key);
+			Item item = { buffer, uses.begin() };
+			items[key] = item;
+			bytes += buffer->size();
+			trim();
+
+			return key;
+		} //put
+
+		//returns the buffer under key, or an empty pointer
+		Buffer get(const std::string& key) {
+			std::lock_guard<std::mutex> guard(lock);
+			auto found = items.find(key);
+			if (found == items.end()) {
+				++misses;
+				return Buffer();
+			}
+
+			++hits;
+			uses.splice(uses.begin(), uses, found->second.use);
+			return found->second.buffer;
+		} //get
+
+		//reads a file through the store, files unchanged since their last load are not read again
+		//returns the content key, or an empty string if the file cannot be read
+		std::string load(const std::string& path, Buffer* buffer = nullptr) {
+			FileSystem::Stat stat = FileSystem::query(path);
+			FileSystem::StatCache::shared().put(path, stat);
+			if (!stat.exists || stat.directory) {
+				return std::string();
+			}
+
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				auto file = files.find(path);
+				if (file != files.end() && file->second.mtime == stat.mtime && file->second.size == stat.size && stat.mtime < file->second.read) {
+					auto found = items.find(file->second.key);
+					if (found != items.end()) {
+						++hits;
+						uses.splice(uses.begin(), uses, found->second.use);
+						if (buffer != nullptr) {
+							*buffer = found->second.buffer;
+						}
+						return file->second.key;
+					}
+				}
+			}
+
+			int64_t read = (int64_t)time(nullptr);
+			IO_Helper::Data* data = IO_Helper::read(path.c_str());
+			if (data->str == nullptr) {
+				delete data;
+				return std::string();
+			}
+			//IO_Helper::read counts the terminator in size
+			std::string key = put(std::string(data->str, data->size - 1));
+			delete data;
+
+			std::lock_guard<std::mutex> guard(lock);
+			++misses;
+			Loaded loaded = { stat.mtime, stat.size, read, key };
+			files[path] = loaded;
+			if (buffer != nullptr) {
+				auto found = items.find(key);
+				*buffer = found != items.end() ? found->second.buffer : Buffer();
+			}
+			return key;
+		} //load
+
+		size_t size() {
+			std::lock_guard<std::mutex> guard(lock);
+			return bytes;
+		} //size
+
+		void stats(size_t& hit, size_t& miss) {
+			std::lock_guard<std::mutex> guard(lock);
+			hit = hits;
+			miss = misses;
+		} //stats
+}; //ContentStore
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstring>
+
+#include "luacpp.hpp"
+#include "diagnostics.hpp"
+
+/*
+*	Lua access to Diagnostics (library "diag")
+*
+*		diag.emit(severity, message [, file [, line]])	severity is "error", "warning" or "note"
+*		diag.error(message [, file [, line]])
+*		diag.warning(message [, file [, line]])
+*		diag.note(message [, file [, line]])
+*		diag.count([severity])							emitted so far, of severity or all
+*		diag.flush()									writes everything emitted so far
+*
+*	Emitting does not wait for the output, messages are written in batches.
+*/
+class DiagnosticsLib {
+	private:
+		static bool severity(const char* name, Diagnostics::Severity& value) {
+			if (strcmp(name, "error") == 0) {
+				value = Diagnostics::FAILURE;
+			} else if (strcmp(name, "warning") == 0) {
+				value = Diagnostics::WARNING;
+			} else if (strcmp(name, "note") == 0) {
+				value = Diagnostics::NOTE;
+			} else {
+				return false;
+			}
+			return true;
+		} //severity
+
+		//message, file and line start at index first
+		static void emit(Lua& lua, Diagnostics::Severity severity, int first) {
+			std::string message = lua.l_checkstring(first);
+			std::string file = lua.isstring(first + 1) ? lua.tostring(first + 1) : "";
+			uint32_t line = (uint32_t)lua.l_optinteger(first + 2, 0);
+			Diagnostics::emit(severity, message, file, line);
+		} //emit
+
+		static int l_emit(Lua::State* L) {
+			Lua lua(L);
+			Diagnostics::Severity value;
+			if (!severity(lua.l_checkstring(1), value)) {
+				return lua.l_argerror(1, "expected \"error\", \"warning\" or \"note\"");
+			}
+			emit(lua, value, 2);
+			return 0;
+		} //l_emit
+
+		static int l_error(Lua::State* L) {
+			Lua lua(L);
+			emit(lua, Diagnostics::FAILURE, 1);
+			return 0;
+		} //l_error
+
+		static int l_warning(Lua::State* L) {
+			Lua lua(L);
+			emit(lua, Diagnostics::WARNING, 1);
+			return 0;
+		} //l_warning
+
+		static int l_note(Lua::State* L) {
+			Lua lua(L);
+			emit(lua, Diagnostics::NOTE, 1);
+			return 0;
+		} //l_note
+
+		static int l_count(Lua::State* L) {
+			Lua lua(L);
+			Diagnostics& diagnostics = Diagnostics::shared();
+			Diagnostics::Severity value;
+			if (lua.isstring(1)) {
+				if (!severity(lua.tostring(1), value)) {
+					return lua.l_argerror(1, "expected \"error\", \"warning\" or \"note\"");
+				}
+				lua.pushnumber((Lua::Number)diagnostics.count(value));
+			} else {
+				lua.pushnumber((Lua::Number)(diagnostics.count(Diagnostics::FAILURE) + diagnostics.count(Diagnostics::WARNING) + diagnostics.count(Diagnostics::NOTE)));
+			}
+			return 1;
+		} //l_count
+
+		static int l_flush(Lua::State*) {
+			Diagnostics::shared().flush();
+			return 0;
+		} //l_flush
+
+	public:
+		static void attach(Lua& lua) {
+			static const Lua::l_Reg lib[] = {
+				{ "emit", l_emit },
+				{ "error", l_error },
+				{ "warning", l_warning },
+				{ "note", l_note },
+				{ "count", l_count },
+				{ "flush", l_flush },
+				{ nullptr, nullptr }
+			};
+			lua.l_register("diag", lib);
+			lua.pop(1);
+		} //attach
+}; //DiagnosticsLib
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <condition_variable>
+#include <stdint.h>
+
+/*
+*	Diagnostics
+*
+*	Errors, warnings and notes of the run. Each thread emits into its own ring buffer
+*	without taking a lock, a writer thread drains the buffers every few milliseconds
+*	and writes whole records to stderr in one write per batch, so lines of different
+*	workers never interleave.
+*
+*	A record is printed once per location (file and line), so the same message at
+*	different places is still listed. close() collapses messages by text, prints how
+*	often each repeated and where, then the totals. A thread whose buffer is full drains
+*	the buffers itself.
+*
+*		Diagnostics::emit(Diagnostics::WARNING, "unused variable x", "main.j", 12);
+*		...
+*		Diagnostics::shared().close();
+*/
+class Diagnostics {
+	public:
+		enum Severity {
+			FAILURE,	//not ERROR, windows.h defines that
+			WARNING,
+			NOTE,
+		};
+
+		struct Record {
+			Severity severity;
+			std::string file;
+			uint32_t line;
+			std::string message;
+		};
+
+	private:
+		static const size_t capacity = 1 << 10;
+
+		//single producer (the owning thread), single consumer (whoever holds draining)
+		struct Buffer {
+			std::atomic<size_t> head;
+			std::atomic<size_t> tail;
+			Record records[capacity];
+
+			Buffer() : head(0), tail(0) { }
+		};
+
+		//most locations the summary lists for a repeated message
+		static const size_t listed = 8;
+
+		struct Seen {
+			size_t count;
+			Record record;
+			std::vector<std::string> locations;
+		};
+
+		std::mutex lock;
+		std::vector<Buffer*> buffers;
+
+		std::mutex draining;
+		std::unordered_set<std::string> seen;	//severity, location and message of records printed
+		std::unordered_map<std::string, size_t> messages;	//severity and message to its entry in repeated
+		std::vector<Seen> repeated;
+
+		std::atomic<size_t> counts[3];
+
+		std::mutex waking;
+		std::condition_variable wake;
+		std::thread writer;
+		bool running;
+		std::atomic<bool> closed;
+
+		Diagnostics() : running(false), closed(false) {
+			for (auto& count : counts) {
+				count = 0;
+			}
+		}
+
+		~Diagnostics() {
+			close();
+			for (auto buffer : buffers) {
+				delete buffer;
+			}
+		}
+
+		Buffer& local() {
+			static thread_local Buffer* buffer = nullptr;
+
+			if (buffer == nullptr) {
+				std::lock_guard<std::mutex> guard(lock);
+				buffer = new Buffer();
+				buffers.push_back(buffer);
+
+				if (!running && !closed) {
+					running = true;
+					writer = std::thread([this] { work(); });
+				}
+			}
+
+			return *buffer;
+		} //local
+
+		static const char* name(Severity severity) {
+			switch (severity) {
+				case FAILURE: return "error";
+				case WARNING: return "warning";
+				default: return "note";
+			}
+		} //name
+
+		//file:line, file or an empty string
+		static std::string location(const Record& record) {
+			std::ostringstream out;
+			out << record.file;
+			if (!record.file.empty() && record.line > 0) {
+				out << ":" << record.line;
+			}
+			return out.str();
+		} //location
+
+		static void format(std::ostream& out, const Record& record) {
+			out << "-- ";
+			if (!record.file.empty()) {
+				out << location(record) << ": ";
+			}
+			if (record.severity != FAILURE) {
+				out << name(record.severity) << ": ";
+			}
+			out << record.message << "\n";
+		} //format
+
+		//writes what the buffers hold, the first occurrence at each location only
+		void drain() {
+			std::lock_guard<std::mutex> guard(draining);
+
+			std::vector<Buffer*> current;
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				current = buffers;
+			}
+
+			std::ostringstream out;
+			for (auto buffer : current) {
+				size_t tail = buffer->tail.load(std::memory_order_relaxed);
+				size_t head = buffer->head.load(std::memory_order_acquire);
+				for (; tail != head; ++tail) {
+					Record& record = buffer->records[tail % capacity];
+
+					std::string key = std::string(1, (char)('0' + record.severity)) + record.message;
+					auto found = messages.find(key);
+					if (found == messages.end()) {
+						found = messages.insert(std::make_pair(key, repeated.size())).first;
+						Seen first = { 0, record, std::vector<std::string>() };
+						repeated.push_back(first);
+					}
+					Seen& entry = repeated[found->second];
+					++entry.count;
+
+					std::string at = location(record);
+					if (seen.insert(key + "\n" + at).second) {
+						entry.locations.push_back(at);
+						format(out, record);
+					}
+				}
+				buffer->tail.store(tail, std::memory_order_release);
+			}
+
+			std::string text = out.str();
+			if (!text.empty()) {
+				std::cerr.write(text.data(), text.size());
+				std::cerr.flush();
+			}
+		} //drain
+
+		void work() {
+			std::unique_lock<std::mutex> guard(waking);
+			while (!closed) {
+				wake.wait_for(guard, std::chrono::milliseconds(5));
+				guard.unlock();
+				drain();
+				guard.lock();
+			}
+		} //work
+
+		//hide copy
+		Diagnostics(const Diagnostics&);
+		Diagnostics& operator=(const Diagnostics&);
+
+	public:
+		static Diagnostics& shared() {
+			static Diagnostics diagnostics;
+			return diagnostics;
+		} //shared
+
+		static void emit(Severity severity, const std::string& message, const std::string& file = std::string(), uint32_t line = 0) {
+			Diagnostics& diagnostics = shared();
+			Buffer& buffer = diagnostics.local();
+			++diagnostics.counts[severity];
+
+			size_t head = buffer.head.load(std::memory_order_relaxed);
+			while (head - buffer.tail.load(std::memory_order_acquire) >= capacity) {
+				diagnostics.drain();
+			}
+
+			Record& record = buffer.records[head % capacity];
+			record.severity = severity;
+			record.file = file;
+			record.line = line;
+			record.message = message;
+			buffer.head.store(head + 1, std::memory_order_release);
+
+			if (severity == FAILURE || diagnostics.closed) {
+				diagnostics.wake.notify_one();
+				if (diagnostics.closed) {
+					diagnostics.drain();
+				}
+			}
+		} //emit
+
+		static void error(const std::string& message) { emit(FAILURE, message); }
+		static void warning(const std::string& message) { emit(WARNING, message); }
+
+		size_t count(Severity severity) const { return counts[severity]; }
+
+		//writes everything emitted so far
+		void flush() { drain(); }
+
+		//stops the writer, writes what is left and the summary
+		void close() {
+			{
+				std::lock_guard<std::mutex> guard(waking);
+				if (closed) {
+					return;
+				}
+				closed = true;
+			}
+			wake.notify_one();
+
+			bool joining;
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				joining = running;
+				running = false;
+			}
+			//the writer takes lock while draining, join without holding it
+			if (joining) {
+				writer.join();
+			}
+
+			drain();
+
+			std::lock_guard<std::mutex> guard(draining);
+			std::ostringstream out;
+			for (auto& entry : repeated) {
+				if (entry.count > 1) {
+					out << "-- (" << entry.count << "x) ";
+					if (entry.record.severity != FAILURE) {
+						out << name(entry.record.severity) << ": ";
+					}
+					out << entry.record.message << "\n";
+
+					if (!entry.locations.empty() && !(entry.locations.size() == 1 && entry.locations[0].empty())) {
+						out << "--     at ";
+						for (size_t i = 0; i < entry.locations.size() && i < listed; ++i) {
+							out << (i > 0 ? ", " : "") << (entry.locations[i].empty() ? "(no file)" : entry.locations[i]);
+						}
+						if (entry.locations.size() > listed) {
+							out << " and " << entry.locations.size() - listed << " more";
+						}
+						out << "\n";
+					}
+				}
+			}
+			if (counts[FAILURE] > 0 || counts[WARNING] > 0) {
+				out << "-- " << counts[FAILURE] << " error(s), " << counts[WARNING] << " warning(s)\n";
+			}
+
+			std::string text = out.str();
+			std::cerr.write(text.data(), text.size());
+			std::cerr.flush();
+		} //close
+}; //Diagnostics
@@ -0,0 +1,18 @@
+#pragma once
+
+/*
+*	Precompiled build modules
+*
+*	Generated by "makefile --embed <output> <module.lua>..." from the module root. Each entry
+*	is the Lua::compile bytecode of one module, keyed by its require name.
+*
+*	Do not edit by hand; regenerate when the modules change.
+*
+*	The repository ships no build modules, so the table is empty: states start with the
+*	standard libraries only, and a project embedding its modules regenerates this file
+*	as a step before compiling makefile.
+*/
+
+static const EmbeddedModule embedded_modules[] = {
+	{ nullptr, nullptr, 0 }
+};
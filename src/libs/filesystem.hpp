@@ -0,0 +1,484 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <condition_variable>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#include "thread pool.hpp"
+#include "trace.hpp"
+
+/*
+*	FileSystem
+*
+*	Directory listing, parallel recursive walks, glob patterns and a stat cache shared
+*	by every lookup of the run. Paths use / as separator on every platform.
+*
+*	On Windows directory listings fill the stat cache with what they learn about each
+*	entry, so a walk followed by stat calls on the files found costs no further system
+*	calls. On POSIX listings take the entry type from d_type and only stat entries whose
+*	type it does not tell.
+*
+*	Walks do not descend into symbolic links (reparse points on Windows) to directories,
+*	so a link loop cannot make them recurse forever.
+*/
+namespace FileSystem {
+	struct Stat {
+		bool exists;
+		bool directory;
+		uint64_t size;
+		int64_t mtime;		//seconds since the epoch
+	};
+
+	struct Entry {
+		std::string name;
+		Stat stat;		//size and mtime are only known where the listing had them
+		bool link;		//symbolic link, stat is of its target
+	};
+
+	inline std::string join(const std::string& dir, const std::string& name) {
+		if (dir.empty() || dir == ".") {
+			return name;
+		}
+		return dir.back() == '/' || dir.back() == '\\' ? dir + name : dir + "/" + name;
+	} //join
+
+	//absolute path of the working directory, empty if it cannot be determined
+	inline std::string currentDirectory() {
+		char buffer[4096];
+#ifdef _WIN32
+		DWORD size = GetCurrentDirectoryA(sizeof(buffer), buffer);
+		return size > 0 && size < sizeof(buffer) ? std::string(buffer, size) : std::string();
+#else
+		return getcwd(buffer, sizeof(buffer)) != nullptr ? std::string(buffer) : std::string();
+#endif
+	} //currentDirectory
+
+	//stats a path without the cache
+	inline Stat query(const std::string& path) {
+		Stat stat = { false, false, 0, 0 };
+
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data)) {
+			stat.exists = true;
+			stat.directory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+			stat.size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+			uint64_t time = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+			stat.mtime = (int64_t)(time / 10000000 - 11644473600ULL);
+		}
+#else
+		struct stat info;
+		if (::stat(path.c_str(), &info) == 0) {
+			stat.exists = true;
+			stat.directory = S_ISDIR(info.st_mode);
+			stat.size = (uint64_t)info.st_size;
+			stat.mtime = (int64_t)info.st_mtime;
+		}
+#endif
+
+		return stat;
+	} //query
+
+	/*
+	*	StatCache
+	*
+	*	Stat results by path for the rest of the run. Scripts that write files invalidate
+	*	them (or clear the cache) to see the new values.
+	*/
+	class StatCache {
+		private:
+			std::mutex lock;
+			std::unordered_map<std::string, Stat> stats;
+
+		public:
+			static StatCache& shared() {
+				static StatCache cache;
+				return cache;
+			} //shared
+
+			Stat get(const std::string& path) {
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					auto found = stats.find(path);
+					if (found != stats.end()) {
+						return found->second;
+					}
+				}
+
+				Stat stat = query(path);
+
+				std::lock_guard<std::mutex> guard(lock);
+				stats[path] = stat;
+				return stat;
+			} //get
+
+			void put(const std::string& path, const Stat& stat) {
+				std::lock_guard<std::mutex> guard(lock);
+				stats[path] = stat;
+			} //put
+
+			void invalidate(const std::string& path) {
+				std::lock_guard<std::mutex> guard(lock);
+				stats.erase(path);
+			} //invalidate
+
+			void clear() {
+				std::lock_guard<std::mutex> guard(lock);
+				stats.clear();
+			} //clear
+	}; //StatCache
+
+	//creates a directory and any missing parents, returns false if it does not exist afterwards
+	inline bool makeDirectories(const std::string& path) {
+		for (size_t i = 1; i <= path.size(); ++i) {
+			if (i == path.size() || path[i] == '/' || path[i] == '\\') {
+				std::string part = path.substr(0, i);
+				if (part.back() == ':') {
+					continue;
+				}
+#ifdef _WIN32
+				CreateDirectoryA(part.c_str(), nullptr);
+#else
+				mkdir(part.c_str(), 0777);
+#endif
+			}
+		}
+
+		StatCache::shared().invalidate(path);
+		Stat stat = query(path);
+		return stat.exists && stat.directory;
+	} //makeDirectories
+
+	//moves from over to, replacing it, so readers of to never see a partial file
+	inline bool replace(const std::string& from, const std::string& to) {
+		StatCache::shared().invalidate(to);
+#ifdef _WIN32
+		return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+	} //replace
+
+	//lists a directory without . and .., returns false if it cannot be read
+	inline bool list(const std::string& dir, std::vector<Entry>& entries) {
+		StatCache& cache = StatCache::shared();
+
+#ifdef _WIN32
+		WIN32_FIND_DATAA data;
+		HANDLE find = FindFirstFileA(join(dir.empty() ? "." : dir, "*").c_str(), &data);
+		if (find == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+
+		do {
+			if (strcmp(data.cFileName, ".") == 0 || strcmp(data.cFileName, "..") == 0) {
+				continue;
+			}
+
+			Entry entry;
+			entry.name = data.cFileName;
+			entry.link = (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
+			entry.stat.exists = true;
+			entry.stat.directory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+			entry.stat.size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+			uint64_t time = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+			entry.stat.mtime = (int64_t)(time / 10000000 - 11644473600ULL);
+
+			cache.put(join(dir, entry.name), entry.stat);
+			entries.push_back(entry);
+		} while (FindNextFileA(find, &data));
+
+		FindClose(find);
+#else
+		DIR* handle = opendir(dir.empty() ? "." : dir.c_str());
+		if (handle == nullptr) {
+			return false;
+		}
+
+		while (struct dirent* item = readdir(handle)) {
+			if (strcmp(item->d_name, ".") == 0 || strcmp(item->d_name, "..") == 0) {
+				continue;
+			}
+
+			Entry entry;
+			entry.name = item->d_name;
+			entry.link = false;
+
+#ifdef DT_DIR
+			if (item->d_type == DT_DIR || item->d_type == DT_REG) {
+				Stat stat = { true, item->d_type == DT_DIR, 0, 0 };
+				entry.stat = stat;
+				entries.push_back(entry);
+				continue;
+			}
+#endif
+
+			std::string path = join(dir, entry.name);
+			struct stat info;
+			if (lstat(path.c_str(), &info) != 0) {
+				continue;
+			}
+			entry.link = S_ISLNK(info.st_mode);
+			entry.stat = query(path);
+
+			cache.put(path, entry.stat);
+			entries.push_back(entry);
+		}
+
+		closedir(handle);
+#endif
+
+		return true;
+	} //list
+
+	/*
+	*	Glob
+	*
+	*	Compiled path pattern, matched one path segment at a time.
+	*
+	*		*		any characters within a segment
+	*		?		one character
+	*		[abc]	one of the characters, [a-z] ranges, [!abc] negated
+	*		**		any number of whole segments
+	*
+	*	Matching ignores case on Windows.
+	*/
+	class Glob {
+		private:
+			std::vector<std::string> segments;
+			bool nocase;
+
+			static bool equal(char a, char b, bool nocase) {
+				return nocase ? tolower((unsigned char)a) == tolower((unsigned char)b) : a == b;
+			} //equal
+
+			//matches one segment pattern against one name
+			bool segment(const char* p, const char* s) const {
+				const char* star = nullptr;
+				const char* resume = nullptr;
+
+				while (*s != 0) {
+					if (*p == '*') {
+						star = p++;
+						resume = s;
+						continue;
+					}
+
+					bool match = false;
+					const char* next = p + 1;
+					if (*p == '?') {
+						match = true;
+					} else if (*p == '[') {
+						const char* c = p + 1;
+						bool negate = *c == '!' || *c == '^';
+						if (negate) {
+							++c;
+						}
+						bool found = false;
+						for (bool first = true; *c != 0 && (first || *c != ']'); ++c, first = false) {
+							if (c[1] == '-' && c[2] != 0 && c[2] != ']') {
+								char low = nocase ? (char)tolower((unsigned char)c[0]) : c[0];
+								char high = nocase ? (char)tolower((unsigned char)c[2]) : c[2];
+								char value = nocase ? (char)tolower((unsigned char)*s) : *s;
+								found = found || (value >= low && value <= high);
+								c += 2;
+							} else {
+								found = found || equal(*c, *s, nocase);
+							}
+						}
+						if (*c == ']') {
+							match = found != negate;
+							next = c + 1;
+						} else {
+							match = equal('[', *s, nocase);
+						}
+					} else if (*p != 0) {
+						match = equal(*p, *s, nocase);
+					}
+
+					if (match) {
+						p = next;
+						++s;
+					} else if (star != nullptr) {
+						p = star + 1;
+						s = ++resume;
+					} else {
+						return false;
+					}
+				}
+
+				while (*p == '*') {
+					++p;
+				}
+				return *p == 0;
+			} //segment
+
+			bool match(size_t i, const std::vector<std::string>& parts, size_t j) const {
+				for (; i < segments.size(); ++i, ++j) {
+					if (segments[i] == "**") {
+						for (size_t k = j; k <= parts.size(); ++k) {
+							if (match(i + 1, parts, k)) {
+								return true;
+							}
+						}
+						return false;
+					}
+					if (j >= parts.size() || !segment(segments[i].c_str(), parts[j].c_str())) {
+						return false;
+					}
+				}
+				return j == parts.size();
+			} //match
+
+			//the root of an absolute path is a segment of its own, "/"
+			static std::vector<std::string> split(const std::string& path) {
+				std::vector<std::string> parts;
+				if (!path.empty() && (path[0] == '/' || path[0] == '\\')) {
+					parts.push_back("/");
+				}
+				std::string part;
+				for (auto c : path) {
+					if (c == '/' || c == '\\') {
+						if (!part.empty() && part != ".") {
+							parts.push_back(part);
+						}
+						part.clear();
+					} else {
+						part += c;
+					}
+				}
+				if (!part.empty() && part != ".") {
+					parts.push_back(part);
+				}
+				return parts;
+			} //split
+
+			static bool wild(const std::string& s) { return s.find_first_of("*?[") != std::string::npos; }
+
+		public:
+#ifdef _WIN32
+			Glob(const std::string& pattern) : segments(split(pattern)), nocase(true) { }
+#else
+			Glob(const std::string& pattern) : segments(split(pattern)), nocase(false) { }
+#endif
+
+			bool matches(const std::string& path) const { return match(0, split(path), 0); }
+
+			//leading directory without wildcards, where a walk for this pattern starts
+			std::string root() const {
+				std::string root;
+				for (size_t i = 0; i + 1 < segments.size() && !wild(segments[i]); ++i) {
+					root = root.empty() ? segments[i] : join(root, segments[i]);
+				}
+				return root;
+			} //root
+
+			//true if the pattern cannot match anything below dir
+			bool prunes(const std::string& dir) const {
+				std::vector<std::string> parts = split(dir);
+				for (size_t i = 0; i < parts.size(); ++i) {
+					if (i >= segments.size()) {
+						return true;
+					}
+					if (segments[i] == "**") {
+						return false;
+					}
+					if (!segment(segments[i].c_str(), parts[i].c_str())) {
+						return true;
+					}
+				}
+				return false;
+			} //prunes
+	}; //Glob
+
+	/*
+	*	Walks dir recursively, listing directories in parallel on the shared thread pool.
+	*	Returns paths of files (and of directories when dirs is set) below dir for which
+	*	accept returns true. Unreadable directories are skipped.
+	*/
+	inline std::vector<std::string> walk(const std::string& dir, bool dirs, const std::function<bool(const std::string&)>& accept, const std::function<bool(const std::string&)>& descend) {
+		Trace::Scope scope("fs", "walk", dir.c_str());
+
+		struct Shared {
+			std::mutex lock;
+			std::condition_variable idle;
+			std::vector<std::string> found;
+			size_t pending;
+		};
+		auto shared = std::make_shared<Shared>();
+		shared->pending = 1;
+
+		std::function<void(std::string)> visit;
+		visit = [&, shared](std::string path) {
+			std::vector<Entry> entries;
+			list(path, entries);
+
+			std::vector<std::string> found;
+			for (auto& entry : entries) {
+				std::string child = join(path, entry.name);
+				if (!entry.stat.exists) {
+					continue;	//dangling link
+				} else if (entry.stat.directory) {
+					if (dirs && accept(child)) {
+						found.push_back(child);
+					}
+					if (!entry.link && descend(child)) {
+						{
+							std::lock_guard<std::mutex> guard(shared->lock);
+							++shared->pending;
+						}
+						ThreadPool::shared().submit([&visit, child] { visit(child); });
+					}
+				} else if (accept(child)) {
+					found.push_back(child);
+				}
+			}
+
+			std::lock_guard<std::mutex> guard(shared->lock);
+			shared->found.insert(shared->found.end(), found.begin(), found.end());
+			if (--shared->pending == 0) {
+				shared->idle.notify_all();
+			}
+		};
+
+		visit(dir);
+
+		std::unique_lock<std::mutex> guard(shared->lock);
+		shared->idle.wait(guard, [&] { return shared->pending == 0; });
+
+		return shared->found;
+	} //walk
+
+	//paths matching a glob pattern
+	inline std::vector<std::string> glob(const std::string& pattern) {
+		Glob compiled(pattern);
+		std::string root = compiled.root();
+
+		return walk(root, false, [&compiled](const std::string& path) {
+			return compiled.matches(path);
+		}, [&compiled](const std::string& path) {
+			return !compiled.prunes(path);
+		});
+	} //glob
+} //FileSystem
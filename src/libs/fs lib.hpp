@@ -0,0 +1,157 @@
+#pragma once
+
+#include "luacpp.hpp"
+#include "filesystem.hpp"
+
+/*
+*	Lua access to FileSystem (library "fs")
+*
+*		fs.walk(dir [, pattern [, dirs]])	files below dir, optionally matching a glob
+*		fs.glob(pattern)					files matching a glob, e.g. "*.j"
+*		fs.list(dir)						names in dir
+*		fs.stat(path)						{ size, mtime, dir } or nil
+*		fs.stat{ path, ... }				stat of each path, false for missing ones
+*		fs.exists(path)
+*		fs.invalidate([path])				forgets a cached stat, or all of them
+*
+*	Stats are cached for the run. Listings and walks fill the cache where the system
+*	hands them the stats anyway.
+*/
+class FileSystemLib {
+	private:
+		static void pushStrings(Lua& lua, const std::vector<std::string>& strings) {
+			lua.createtable((int)strings.size(), 0);
+			for (size_t i = 0; i < strings.size(); ++i) {
+				lua.pushlstring(strings[i].data(), strings[i].size());
+				lua.rawseti(-2, (int)i + 1);
+			}
+		} //pushStrings
+
+		static void pushStat(Lua& lua, const FileSystem::Stat& stat) {
+			if (!stat.exists) {
+				lua.pushboolean(false);
+				return;
+			}
+
+			lua.createtable(0, 3);
+			lua.pushnumber((Lua::Number)stat.size);
+			lua.setfield(-2, "size");
+			lua.pushnumber((Lua::Number)stat.mtime);
+			lua.setfield(-2, "mtime");
+			lua.pushboolean(stat.directory);
+			lua.setfield(-2, "dir");
+		} //pushStat
+
+		static int l_walk(Lua::State* L) {
+			Lua lua(L);
+			std::string dir = lua.l_checkstring(1);
+			bool dirs = lua.toboolean(3) != 0;
+
+			std::vector<std::string> found;
+			if (lua.isstring(2)) {
+				//the pattern is relative to dir, walked paths start with dir joined to a name
+				FileSystem::Glob glob(lua.tostring(2));
+				size_t skip = FileSystem::join(dir, "").size();
+				found = FileSystem::walk(dir, dirs, [&](const std::string& path) {
+					return glob.matches(path.substr(skip));
+				}, [&](const std::string& path) {
+					return !glob.prunes(path.substr(skip));
+				});
+			} else {
+				found = FileSystem::walk(dir, dirs, [](const std::string&) { return true; }, [](const std::string&) { return true; });
+			}
+
+			pushStrings(lua, found);
+			return 1;
+		} //l_walk
+
+		static int l_glob(Lua::State* L) {
+			Lua lua(L);
+			pushStrings(lua, FileSystem::glob(lua.l_checkstring(1)));
+			return 1;
+		} //l_glob
+
+		static int l_list(Lua::State* L) {
+			Lua lua(L);
+			std::vector<FileSystem::Entry> entries;
+			if (!FileSystem::list(lua.l_checkstring(1), entries)) {
+				lua.pushnil();
+				lua.pushfstring("cannot list %s", lua.tostring(1));
+				return 2;
+			}
+
+			std::vector<std::string> names;
+			for (auto& entry : entries) {
+				names.push_back(entry.name);
+			}
+			pushStrings(lua, names);
+			return 1;
+		} //l_list
+
+		static int l_stat(Lua::State* L) {
+			Lua lua(L);
+			FileSystem::StatCache& cache = FileSystem::StatCache::shared();
+
+			if (!lua.istable(1)) {
+				FileSystem::Stat stat = cache.get(lua.l_checkstring(1));
+				if (!stat.exists) {
+					lua.pushnil();
+				} else {
+					pushStat(lua, stat);
+				}
+				return 1;
+			}
+
+			int count = (int)lua.objlen(1);
+			std::vector<std::string> paths;
+			for (int i = 1; i <= count; ++i) {
+				lua.rawgeti(1, i);
+				paths.push_back(lua.isstring(-1) ? lua.tostring(-1) : "");
+				lua.pop(1);
+			}
+
+			//uncached paths are queried in parallel
+			std::vector<FileSystem::Stat> stats(paths.size());
+			ThreadPool::shared().forEach(paths.size(), [&](size_t i) {
+				stats[i] = cache.get(paths[i]);
+			});
+
+			lua.createtable(count, 0);
+			for (int i = 0; i < count; ++i) {
+				pushStat(lua, stats[i]);
+				lua.rawseti(-2, i + 1);
+			}
+			return 1;
+		} //l_stat
+
+		static int l_exists(Lua::State* L) {
+			Lua lua(L);
+			lua.pushboolean(FileSystem::StatCache::shared().get(lua.l_checkstring(1)).exists);
+			return 1;
+		} //l_exists
+
+		static int l_invalidate(Lua::State* L) {
+			Lua lua(L);
+			if (lua.isstring(1)) {
+				FileSystem::StatCache::shared().invalidate(lua.tostring(1));
+			} else {
+				FileSystem::StatCache::shared().clear();
+			}
+			return 0;
+		} //l_invalidate
+
+	public:
+		static void attach(Lua& lua) {
+			static const Lua::l_Reg lib[] = {
+				{ "walk", l_walk },
+				{ "glob", l_glob },
+				{ "list", l_list },
+				{ "stat", l_stat },
+				{ "exists", l_exists },
+				{ "invalidate", l_invalidate },
+				{ nullptr, nullptr }
+			};
+			lua.l_register("fs", lib);
+			lua.pop(1);
+		} //attach
+}; //FileSystemLib
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <stdint.h>
+
+/*
+*	Hash128
+*
+*	MurmurHash3 (x64, 128 bit) for content addressing. Bytes can be fed in pieces with
+*	update, the result is the same as hashing them in one go.
+*/
+class Hash128 {
+	private:
+		uint64_t h1;
+		uint64_t h2;
+		uint64_t length;
+
+		unsigned char tail[16];
+		size_t pending;
+
+		static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+		static uint64_t fmix(uint64_t k) {
+			k ^= k >> 33;
+			k *= 0xff51afd7ed558ccdULL;
+			k ^= k >> 33;
+			k *= 0xc4ceb9fe1a85ec53ULL;
+			k ^= k >> 33;
+			return k;
+		} //fmix
+
+		void block(const unsigned char* data) {
+			static const uint64_t c1 = 0x87c37b91114253d5ULL;
+			static const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+			uint64_t k1, k2;
+			memcpy(&k1, data, 8);
+			memcpy(&k2, data + 8, 8);
+
+			k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+			h1 = rotl(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+			k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2;
+			h2 = rotl(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+		} //block
+
+	public:
+		Hash128(uint64_t seed = 0) : h1(seed), h2(seed), length(0), pending(0) { }
+
+		void update(const void* data, size_t size) {
+			const unsigned char* bytes = (const unsigned char*)data;
+			length += size;
+
+			if (pending > 0) {
+				size_t take = 16 - pending < size ? 16 - pending : size;
+				memcpy(tail + pending, bytes, take);
+				pending += take;
+				bytes += take;
+				size -= take;
+				if (pending < 16) {
+					return;
+				}
+				block(tail);
+				pending = 0;
+			}
+
+			for (; size >= 16; size -= 16, bytes += 16) {
+				block(bytes);
+			}
+
+			memcpy(tail, bytes, size);
+			pending = size;
+		} //update
+
+		void update(const std::string& s) { update(s.data(), s.size()); }
+
+		//32 hex digits
+		std::string hex() const {
+			static const uint64_t c1 = 0x87c37b91114253d5ULL;
+			static const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+			uint64_t a = h1;
+			uint64_t b = h2;
+			uint64_t k1 = 0;
+			uint64_t k2 = 0;
+
+			for (size_t i = pending; i > 8; --i) {
+				k2 ^= (uint64_t)tail[i - 1] << ((i - 9) * 8);
+			}
+			if (pending > 8) {
+				k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; b ^= k2;
+			}
+			for (size_t i = pending < 8 ? pending : 8; i > 0; --i) {
+				k1 ^= (uint64_t)tail[i - 1] << ((i - 1) * 8);
+			}
+			if (pending > 0) {
+				k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; a ^= k1;
+			}
+
+			a ^= length;
+			b ^= length;
+			a += b;
+			b += a;
+			a = fmix(a);
+			b = fmix(b);
+			a += b;
+			b += a;
+
+			static const char* digits = "0123456789abcdef";
+			std::string out(32, '0');
+			for (int i = 0; i < 16; ++i) {
+				out[15 - i] = digits[(a >> (i * 4)) & 0xf];
+				out[31 - i] = digits[(b >> (i * 4)) & 0xf];
+			}
+			return out;
+		} //hex
+
+		static std::string of(const void* data, size_t size) {
+			Hash128 hash;
+			hash.update(data, size);
+			return hash.hex();
+		} //of
+
+		static std::string of(const std::string& s) { return of(s.data(), s.size()); }
+}; //Hash128
@@ -5,6 +5,8 @@
 
 #include <iostream>
 
+#include "trace.hpp"
+
 using namespace std;
 
 class IO_Helper {
@@ -18,6 +20,7 @@ class IO_Helper {
 		};
 
 		static Data* read(const char* filename) {
+			Trace::Scope scope("io", "read", filename);
 			Data& data = *new Data();
 
 			// open the file for binary reading
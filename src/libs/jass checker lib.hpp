@@ -0,0 +1,201 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <exception>
+
+#include "luacpp.hpp"
+#include "luafile lib.hpp"
+#include "jass checker.hpp"
+
+/*
+*	Lua access to JassChecker (library "jass", userdata "JassCheck")
+*
+*		jass.check(code [, map])	errors of code, a LuaFile or a string
+*		jass.start(code [, map])	checks in the background and returns a JassCheck
+*
+*		check:done()				true once the check finished
+*		check:wait()				errors, waiting for the check to finish
+*
+*	A check that fails (out of memory) raises its error from check or wait.
+*
+*	map is a list of { line = output line, file = vJASS file, source = line in file }
+*	segments. Each error is { line, file, source, message }, file and source are nil
+*	for lines no segment covers.
+*
+*	start copies the code, so the LuaFile can be written out while it is checked
+*
+*		local check = jass.start(output, map)
+*		output:dump("war3map.j")
+*		local errors = check:wait()
+*/
+class JassCheckerLib {
+	private:
+		struct Task {
+			std::string code;
+			std::vector<JassChecker::Segment> segments;
+			std::vector<JassChecker::Error> errors;
+			std::string failure;	//what the check threw, raised on the script thread
+			std::atomic<bool> finished;
+			std::thread thread;
+
+			Task() : finished(false) { }
+
+			//never throws, it runs on a thread of its own
+			void run() {
+				try {
+					JassChecker checker;
+					checker.map(segments);
+					errors = checker.check(code.data(), code.data() + code.size());
+				} catch (const std::exception& e) {
+					failure = e.what();
+				} catch (...) {
+					failure = "unknown exception";
+				}
+				finished = true;
+			} //run
+		};
+
+		static Task* check(Lua& lua, int index) {
+			Task* task = *(Task**)lua.l_checkudata(index, "JassCheck");
+			if (task == nullptr) {
+				lua.l_error("JassCheck is closed");
+			}
+			return task;
+		} //check
+
+		//reads the code and map arguments into task
+		static void read(Lua& lua, Task& task) {
+			if (lua.type(1) == LUA_TSTRING) {
+				size_t size;
+				const char* code = lua.tolstring(1, &size);
+				task.code.assign(code, size);
+			} else {
+				task.code = LuaFileLib::check(lua, 1)->str();
+			}
+
+			if (lua.istable(2)) {
+				for (int i = 1; ; ++i) {
+					lua.rawgeti(2, i);
+					if (!lua.istable(-1)) {
+						lua.pop(1);
+						break;
+					}
+					JassChecker::Segment segment;
+					lua.getfield(-1, "line");
+					segment.line = (uint32_t)lua.tointeger(-1);
+					lua.getfield(-2, "file");
+					segment.file = lua.isstring(-1) ? lua.tostring(-1) : "";
+					lua.getfield(-3, "source");
+					segment.source = (uint32_t)lua.tointeger(-1);
+					lua.pop(4);
+					task.segments.push_back(segment);
+				}
+			}
+		} //read
+
+		//pushes the errors of a finished task, or raises the failure of its check
+		static void push(Lua& lua, const Task& task) {
+			if (!task.failure.empty()) {
+				lua.l_error("jass check failed: %s", task.failure.c_str());
+			}
+
+			const std::vector<JassChecker::Error>& errors = task.errors;
+			lua.createtable((int)errors.size(), 0);
+			for (size_t i = 0; i < errors.size(); ++i) {
+				const JassChecker::Error& error = errors[i];
+				lua.createtable(0, 4);
+				lua.pushnumber((Lua::Number)error.line);
+				lua.setfield(-2, "line");
+				if (!error.file.empty()) {
+					lua.pushlstring(error.file.data(), error.file.size());
+					lua.setfield(-2, "file");
+					lua.pushnumber((Lua::Number)error.source);
+					lua.setfield(-2, "source");
+				}
+				lua.pushlstring(error.message.data(), error.message.size());
+				lua.setfield(-2, "message");
+				lua.rawseti(-2, (int)i + 1);
+			}
+		} //push
+
+		static int l_check(Lua::State* L) {
+			Lua lua(L);
+			Task task;
+			read(lua, task);
+			task.run();
+			push(lua, task);
+			return 1;
+		} //l_check
+
+		static int l_start(Lua::State* L) {
+			Lua lua(L);
+			Task* task = new Task();
+			read(lua, *task);
+			try {
+				task->thread = std::thread([task] { task->run(); });
+			} catch (const std::exception& e) {
+				delete task;
+				return lua.l_error("jass.start: %s", e.what());
+			}
+
+			*(Task**)lua.newuserdata(sizeof(Task*)) = task;
+			lua.l_getmetatable("JassCheck");
+			lua.setmetatable(-2);
+			return 1;
+		} //l_start
+
+		static int l_done(Lua::State* L) {
+			Lua lua(L);
+			lua.pushboolean(check(lua, 1)->finished);
+			return 1;
+		} //l_done
+
+		static int l_wait(Lua::State* L) {
+			Lua lua(L);
+			Task* task = check(lua, 1);
+			if (task->thread.joinable()) {
+				task->thread.join();
+			}
+			push(lua, *task);
+			return 1;
+		} //l_wait
+
+		static int l_gc(Lua::State* L) {
+			Lua lua(L);
+			Task** task = (Task**)lua.l_checkudata(1, "JassCheck");
+			if (*task != nullptr) {
+				if ((*task)->thread.joinable()) {
+					(*task)->thread.join();
+				}
+				delete *task;
+				*task = nullptr;
+			}
+			return 0;
+		} //l_gc
+
+	public:
+		static void attach(Lua& lua) {
+			static const Lua::l_Reg methods[] = {
+				{ "done", l_done },
+				{ "wait", l_wait },
+				{ nullptr, nullptr }
+			};
+			static const Lua::l_Reg lib[] = {
+				{ "check", l_check },
+				{ "start", l_start },
+				{ nullptr, nullptr }
+			};
+
+			lua.l_newmetatable("JassCheck");
+			lua.pushcfunction(l_gc);
+			lua.setfield(-2, "__gc");
+			lua.newtable();
+			lua.l_register(nullptr, methods);
+			lua.setfield(-2, "__index");
+			lua.pop(1);
+
+			lua.l_register("jass", lib);
+			lua.pop(1);
+		} //attach
+}; //JassCheckerLib
@@ -0,0 +1,864 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "jass lexer.hpp"
+#include "jass symbols.hpp"
+#include "thread pool.hpp"
+#include "trace.hpp"
+
+/*
+*	JassChecker
+*
+*	Syntax and type checks of generated JASS in memory. Declarations (types, globals,
+*	natives and function signatures) are read in one pass, then function bodies are
+*	checked in parallel on the shared thread pool. Names not declared in the checked
+*	code are looked up in JassSymbols::shared(), so open the common.j and Blizzard.j
+*	database first.
+*
+*	Checked: declaration before use, argument counts and types, assignments, returns,
+*	conditions, constants, arrays, block structure and locals after statements.
+*
+*	Errors are reported by output line and mapped back to the vJASS file and line
+*	through segments, each saying that output lines from line on come from file at
+*	source onwards.
+*/
+class JassChecker {
+	public:
+		struct Segment {
+			uint32_t line;
+			std::string file;
+			uint32_t source;
+		};
+
+		struct Error {
+			uint32_t line;		//output line
+			std::string file;	//empty when no segment covers the line
+			uint32_t source;
+			std::string message;
+		};
+
+	private:
+		typedef Jass::Token Token;
+		typedef std::vector<Token> Tokens;
+
+		struct Variable {
+			std::string type;
+			bool array;
+			bool constant;
+		};
+
+		struct Function {
+			std::string returns;
+			std::vector<std::string> params;
+			std::vector<std::string> names;
+			size_t order;	//0 for natives of the symbol database
+		};
+
+		//statements of a function, tokens [begin, end)
+		struct Body {
+			std::string name;
+			size_t begin;
+			size_t end;
+			size_t order;
+			uint32_t line;	//of endfunction
+		};
+
+		//what an expression can see
+		struct Scope {
+			std::unordered_map<std::string, Variable> locals;
+			size_t limit;		//functions of a lower order are declared
+			std::vector<Error> errors;
+		};
+
+		std::vector<Segment> segments;
+
+		Tokens tokens;
+		std::unordered_map<std::string, std::string> types;
+		std::unordered_map<std::string, Variable> globals;
+		std::unordered_map<std::string, Function> functions;
+		std::vector<Body> bodies;
+
+		static std::string text(const Token& token) { return std::string(token.start, token.size); }
+
+		static void report(Scope& scope, const Token& at, const std::string& message) {
+			Error error = { at.line, std::string(), 0, message };
+			scope.errors.push_back(error);
+		} //report
+
+		static bool numeric(const std::string& type) { return type == "integer" || type == "real"; }
+
+		bool isType(const std::string& name) const {
+			if (name == "integer" || name == "real" || name == "boolean" || name == "string" || name == "code" || name == "handle") {
+				return true;
+			}
+			if (types.find(name) != types.end()) {
+				return true;
+			}
+			const JassSymbols::Symbol* symbol = JassSymbols::shared().find(name);
+			return symbol != nullptr && symbol->kind == JassSymbols::TYPE;
+		} //isType
+
+		std::string parent(const std::string& type) const {
+			auto found = types.find(type);
+			if (found != types.end()) {
+				return found->second;
+			}
+			const JassSymbols::Symbol* symbol = JassSymbols::shared().find(type);
+			return symbol != nullptr && symbol->kind == JassSymbols::TYPE ? JassSymbols::shared().string(symbol->type) : std::string();
+		} //parent
+
+		bool extends(std::string type, const std::string& base) const {
+			for (int depth = 0; depth < 64 && !type.empty(); ++depth) {
+				if (type == base) {
+					return true;
+				}
+				type = parent(type);
+			}
+			return false;
+		} //extends
+
+		//an empty type stands for an expression that already failed, it converts to anything
+		bool assignable(const std::string& target, const std::string& source) const {
+			if (target.empty() || source.empty() || target == source) {
+				return true;
+			}
+			if (target == "real" && source == "integer") {
+				return true;
+			}
+			if (source == "null") {
+				return !numeric(target) && target != "boolean";
+			}
+			return extends(source, target);
+		} //assignable
+
+		bool variable(const Scope& scope, const std::string& name, Variable& found) const {
+			auto local = scope.locals.find(name);
+			if (local != scope.locals.end()) {
+				found = local->second;
+				return true;
+			}
+
+			auto global = globals.find(name);
+			if (global != globals.end()) {
+				found = global->second;
+				return true;
+			}
+
+			const JassSymbols& symbols = JassSymbols::shared();
+			const JassSymbols::Symbol* symbol = symbols.find(name);
+			if (symbol == nullptr || symbol->kind != JassSymbols::GLOBAL) {
+				return false;
+			}
+			found.type = symbols.string(symbol->type);
+			found.array = (symbol->flags & JassSymbols::ARRAY) != 0;
+			found.constant = (symbol->flags & JassSymbols::CONSTANT) != 0;
+			return true;
+		} //variable
+
+		bool function(const std::string& name, Function& found) const {
+			auto declared = functions.find(name);
+			if (declared != functions.end()) {
+				found = declared->second;
+				return true;
+			}
+
+			const JassSymbols& symbols = JassSymbols::shared();
+			const JassSymbols::Symbol* symbol = symbols.find(name);
+			if (symbol == nullptr || (symbol->kind != JassSymbols::NATIVE && symbol->kind != JassSymbols::FUNCTION)) {
+				return false;
+			}
+			found.returns = symbols.string(symbol->type);
+			found.order = 0;
+			for (uint32_t i = 0; i < symbol->count; ++i) {
+				found.params.push_back(symbols.paramType(*symbol, i));
+			}
+			return true;
+		} //function
+
+		/*
+		*	Parser
+		*
+		*	Statement and expression checks over a token range. A syntax error ends the
+		*	statement, the caller skips to the next line.
+		*/
+		class Parser {
+			private:
+				const JassChecker& checker;
+				Scope& scope;
+
+				void syntax(const std::string& message) {
+					if (!failed) {
+						report(scope, peek(), message);
+						failed = true;
+					}
+				} //syntax
+
+				void requireBoolean(const std::string& type, const Token& at) {
+					if (!type.empty() && type != "boolean") {
+						report(scope, at, "expected boolean, got " + type);
+					}
+				} //requireBoolean
+
+				std::string arithmetic(const Token& op, const std::string& a, const std::string& b) {
+					if (a.empty() || b.empty()) {
+						return std::string();
+					}
+					if (op.is('+') && (a == "string" || a == "null") && (b == "string" || b == "null")) {
+						return "string";
+					}
+					if (numeric(a) && numeric(b)) {
+						return a == "real" || b == "real" ? "real" : "integer";
+					}
+					report(scope, op, "bad types for " + text(op) + ": " + a + " and " + b);
+					return std::string();
+				} //arithmetic
+
+				std::string call(const Token& name) {
+					std::vector<std::pair<std::string, Token>> args;
+					if (!accept(")")) {
+						do {
+							Token at = peek();
+							args.push_back(std::make_pair(expression(), at));
+						} while (!failed && accept(","));
+						expect(")");
+					}
+					if (failed) {
+						return std::string();
+					}
+
+					Function found;
+					if (!checker.function(text(name), found)) {
+						report(scope, name, "undeclared function " + text(name));
+						return std::string();
+					}
+					if (found.order >= scope.limit) {
+						report(scope, name, "function " + text(name) + " used before its declaration");
+					}
+
+					if (args.size() != found.params.size()) {
+						report(scope, name, "wrong number of arguments to " + text(name) + ", expected " + std::to_string(found.params.size()));
+					} else {
+						for (size_t i = 0; i < args.size(); ++i) {
+							if (!checker.assignable(found.params[i], args[i].first)) {
+								report(scope, args[i].second, "argument " + std::to_string(i + 1) + " of " + text(name) + ": cannot convert " + args[i].first + " to " + found.params[i]);
+							}
+						}
+					}
+
+					return found.returns;
+				} //call
+
+				std::string primary() {
+					Token token = peek();
+
+					switch (token.type) {
+						case Jass::INTEGER: ++at; return "integer";
+						case Jass::REAL: ++at; return "real";
+						case Jass::STRING: ++at; return "string";
+						case Jass::IDENTIFIER: break;
+						default:
+							if (accept("(")) {
+								std::string type = expression();
+								expect(")");
+								return type;
+							}
+							syntax("expected an expression");
+							return std::string();
+					}
+
+					++at;
+					if (token.is("true") || token.is("false")) {
+						return "boolean";
+					}
+					if (token.is("null")) {
+						return "null";
+					}
+
+					if (token.is("function")) {
+						Token name = peek();
+						if (name.type != Jass::IDENTIFIER) {
+							syntax("expected a function name");
+							return std::string();
+						}
+						++at;
+						Function found;
+						if (!checker.function(text(name), found)) {
+							report(scope, name, "undeclared function " + text(name));
+						} else if (found.order >= scope.limit) {
+							report(scope, name, "function " + text(name) + " used before its declaration");
+						} else if (!found.params.empty()) {
+							report(scope, name, "function " + text(name) + " used as code must take nothing");
+						}
+						return "code";
+					}
+
+					if (accept("(")) {
+						return call(token);
+					}
+
+					Variable found;
+					bool known = checker.variable(scope, text(token), found);
+					if (!known) {
+						report(scope, token, "undeclared variable " + text(token));
+					}
+
+					if (accept("[")) {
+						Token index = peek();
+						std::string type = expression();
+						expect("]");
+						if (!checker.assignable("integer", type) || type == "null") {
+							report(scope, index, "array index must be an integer");
+						}
+						if (known && !found.array) {
+							report(scope, token, text(token) + " is not an array");
+						}
+					} else if (known && found.array) {
+						report(scope, token, "array " + text(token) + " used without an index");
+					}
+
+					return known ? found.type : std::string();
+				} //primary
+
+				std::string unary() {
+					Token op = peek();
+					if (accept("-") || accept("+")) {
+						std::string type = unary();
+						if (!type.empty() && !numeric(type)) {
+							report(scope, op, "bad type for unary " + text(op) + ": " + type);
+							return std::string();
+						}
+						return type;
+					}
+					return primary();
+				} //unary
+
+				std::string multiplicative() {
+					std::string type = unary();
+					while (!failed && (peek().is('*') || peek().is('/'))) {
+						Token op = tokens[at++];
+						type = arithmetic(op, type, unary());
+					}
+					return type;
+				} //multiplicative
+
+				std::string additive() {
+					std::string type = multiplicative();
+					while (!failed && (peek().is('+') || peek().is('-'))) {
+						Token op = tokens[at++];
+						type = arithmetic(op, type, multiplicative());
+					}
+					return type;
+				} //additive
+
+				std::string comparison() {
+					std::string type = additive();
+					for (;;) {
+						Token op = peek();
+						bool equality = op.is("==") || op.is("!=");
+						if (failed || op.type != Jass::OPERATOR || !(equality || op.is('<') || op.is('>') || op.is("<=") || op.is(">="))) {
+							return type;
+						}
+						++at;
+
+						std::string other = additive();
+						if (!type.empty() && !other.empty()) {
+							if (equality) {
+								if (!(numeric(type) && numeric(other)) && !checker.assignable(type, other) && !checker.assignable(other, type)) {
+									report(scope, op, "comparing " + type + " with " + other);
+								}
+							} else if (!numeric(type) || !numeric(other)) {
+								report(scope, op, "bad types for " + text(op) + ": " + type + " and " + other);
+							}
+						}
+						type = "boolean";
+					}
+				} //comparison
+
+				std::string negation() {
+					Token op = peek();
+					if (accept("not")) {
+						requireBoolean(negation(), op);
+						return "boolean";
+					}
+					return comparison();
+				} //negation
+
+				std::string conjunction() {
+					std::string type = negation();
+					while (!failed && peek().is("and")) {
+						Token op = tokens[at++];
+						requireBoolean(type, op);
+						requireBoolean(negation(), op);
+						type = "boolean";
+					}
+					return type;
+				} //conjunction
+
+			public:
+				const Tokens& tokens;
+				size_t at;
+				bool failed;
+
+				Parser(const JassChecker& checker, const Tokens& tokens, size_t at, Scope& scope) : checker(checker), scope(scope), tokens(tokens), at(at), failed(false) { }
+
+				const Token& peek() const { return tokens[at]; }
+
+				bool accept(const char* s) {
+					if (tokens[at].type != Jass::STRING && tokens[at].is(s)) {
+						++at;
+						return true;
+					}
+					return false;
+				} //accept
+
+				void expect(const char* s) {
+					if (!accept(s)) {
+						syntax(std::string("expected ") + s);
+					}
+				} //expect
+
+				//a name that is not a keyword
+				bool name(Token& token) {
+					token = peek();
+					if (token.type != Jass::IDENTIFIER) {
+						syntax("expected a name");
+						return false;
+					}
+					++at;
+					return true;
+				} //name
+
+				bool type(std::string& type) {
+					Token token;
+					if (!name(token)) {
+						return false;
+					}
+					type = text(token);
+					if (!checker.isType(type)) {
+						report(scope, token, "undeclared type " + type);
+					}
+					return true;
+				} //type
+
+				std::string expression() {
+					std::string type = conjunction();
+					while (!failed && peek().is("or")) {
+						Token op = tokens[at++];
+						requireBoolean(type, op);
+						requireBoolean(conjunction(), op);
+						type = "boolean";
+					}
+					return type;
+				} //expression
+
+				//boolean expression of if, elseif and exitwhen
+				void condition() {
+					Token start = peek();
+					requireBoolean(expression(), start);
+				} //condition
+
+				//checks that the expression at the current token converts to target
+				void value(const std::string& target) {
+					Token start = peek();
+					std::string type = expression();
+					if (!failed && !checker.assignable(target, type)) {
+						report(scope, start, "cannot convert " + type + " to " + target);
+					}
+				} //value
+
+				std::string callStatement(const Token& name) { return call(name); }
+
+				void skipLine() {
+					while (peek().type != Jass::NEWLINE && peek().type != Jass::END) {
+						++at;
+					}
+				} //skipLine
+
+				//ends a statement, anything left on its line is an error
+				void endLine() {
+					if (!failed && peek().type != Jass::NEWLINE && peek().type != Jass::END) {
+						syntax("expected end of line");
+					}
+					skipLine();
+				} //endLine
+		}; //Parser
+
+		//name takes type name, ... returns type
+		bool signature(Parser& parser, Token& name, Function& function) {
+			if (!parser.name(name)) {
+				return false;
+			}
+			parser.expect("takes");
+			if (!parser.accept("nothing")) {
+				do {
+					std::string type;
+					Token param;
+					if (!parser.type(type) || !parser.name(param)) {
+						return false;
+					}
+					function.params.push_back(type);
+					function.names.push_back(text(param));
+				} while (parser.accept(","));
+			}
+			parser.expect("returns");
+			if (parser.failed) {
+				return false;
+			}
+			if (parser.accept("nothing")) {
+				function.returns = "nothing";
+				return true;
+			}
+			return parser.type(function.returns);
+		} //signature
+
+		//[constant] type [array] name [= value]
+		void global(Parser& parser, Scope& scope) {
+			Variable variable = { std::string(), false, parser.accept("constant") };
+			Token name;
+			if (!parser.type(variable.type)) {
+				return;
+			}
+			variable.array = parser.accept("array");
+			if (!parser.name(name)) {
+				return;
+			}
+
+			if (parser.accept("=")) {
+				if (variable.array) {
+					report(scope, name, "array " + text(name) + " cannot be initialized");
+				}
+				parser.value(variable.type);
+			} else if (variable.constant) {
+				report(scope, name, "constant " + text(name) + " needs a value");
+			}
+
+			if (globals.find(text(name)) != globals.end()) {
+				report(scope, name, "redeclared global " + text(name));
+			}
+			globals[text(name)] = variable;
+		} //global
+
+		//reads declarations and finds the function bodies
+		void declarations(Scope& scope) {
+			size_t order = 1;
+			bool inGlobals = false;
+
+			Parser parser(*this, tokens, 0, scope);
+			for (;;) {
+				const Token& token = parser.peek();
+				if (token.type == Jass::END) {
+					break;
+				}
+				if (token.type == Jass::NEWLINE) {
+					++parser.at;
+					continue;
+				}
+
+				parser.failed = false;
+				scope.limit = order;
+
+				if (inGlobals) {
+					if (parser.accept("endglobals")) {
+						inGlobals = false;
+					} else {
+						global(parser, scope);
+					}
+				} else if (parser.accept("globals")) {
+					inGlobals = true;
+				} else if (parser.accept("type")) {
+					Token name;
+					std::string base;
+					if (parser.name(name)) {
+						parser.expect("extends");
+						if (!parser.failed && parser.type(base)) {
+							if (isType(text(name))) {
+								report(scope, name, "redeclared type " + text(name));
+							}
+							types[text(name)] = base;
+						}
+					}
+				} else {
+					bool constant = parser.accept("constant");
+					bool native = parser.accept("native");
+					if (!native && !parser.accept("function")) {
+						parser.skipLine();
+						if (constant) {
+							report(scope, token, "expected native or function");
+						} else {
+							report(scope, token, "unexpected " + text(token));
+						}
+						continue;
+					}
+
+					Token name;
+					Function function;
+					function.order = order++;
+					if (signature(parser, name, function)) {
+						if (functions.find(text(name)) != functions.end()) {
+							report(scope, name, "redeclared function " + text(name));
+						}
+						functions[text(name)] = function;
+					}
+					parser.endLine();
+
+					if (!native) {
+						//the body runs to the endfunction that starts a line
+						Body body = { parser.failed ? std::string() : text(name), parser.at, parser.at, function.order, 0 };
+						bool closed = false;
+						while (parser.peek().type != Jass::END && !closed) {
+							bool lineStart = parser.at == 0 || tokens[parser.at - 1].type == Jass::NEWLINE;
+							const Token& current = parser.peek();
+							if (lineStart && current.is("endfunction")) {
+								body.end = parser.at;
+								body.line = current.line;
+								++parser.at;
+								closed = true;
+							} else if (lineStart && (current.is("function") || current.is("native") || current.is("globals"))) {
+								break;
+							} else {
+								++parser.at;
+							}
+						}
+						if (!closed) {
+							body.end = parser.at;
+							report(scope, token, "missing endfunction");
+						}
+						if (!body.name.empty()) {
+							bodies.push_back(body);
+						}
+					}
+				}
+
+				parser.endLine();
+			}
+
+			if (inGlobals) {
+				report(scope, parser.peek(), "missing endglobals");
+			}
+		} //declarations
+
+		void check(const Body& body, Scope& scope) {
+			const Function& function = functions.at(body.name);
+			for (size_t i = 0; i < function.params.size(); ++i) {
+				Variable param = { function.params[i], false, false };
+				scope.locals[function.names[i]] = param;
+			}
+			scope.limit = body.order + 1;
+
+			//open blocks: i for if, e for else, l for loop
+			std::string blocks;
+			bool statements = false;
+			bool returns = false;
+
+			Parser parser(*this, tokens, body.begin, scope);
+			while (parser.at < body.end) {
+				const Token token = parser.peek();
+				if (token.type == Jass::NEWLINE) {
+					++parser.at;
+					continue;
+				}
+
+				parser.failed = false;
+				parser.accept("debug");
+
+				if (parser.accept("local")) {
+					if (statements) {
+						report(scope, token, "local declared after statements");
+					}
+					Variable local = { std::string(), false, false };
+					Token name;
+					if (parser.type(local.type)) {
+						local.array = parser.accept("array");
+						if (parser.name(name)) {
+							if (parser.accept("=")) {
+								if (local.array) {
+									report(scope, name, "array " + text(name) + " cannot be initialized");
+								}
+								parser.value(local.type);
+							}
+							if (scope.locals.find(text(name)) != scope.locals.end()) {
+								report(scope, name, "redeclared local " + text(name));
+							}
+							scope.locals[text(name)] = local;
+						}
+					}
+				} else {
+					statements = true;
+
+					if (parser.accept("set")) {
+						Token name;
+						Variable target;
+						if (parser.name(name)) {
+							bool known = variable(scope, text(name), target);
+							if (!known) {
+								report(scope, name, "undeclared variable " + text(name));
+							} else if (target.constant) {
+								report(scope, name, "cannot set constant " + text(name));
+							}
+							if (parser.accept("[")) {
+								Token index = parser.peek();
+								std::string type = parser.expression();
+								parser.expect("]");
+								if (!assignable("integer", type) || type == "null") {
+									report(scope, index, "array index must be an integer");
+								}
+								if (known && !target.array) {
+									report(scope, name, text(name) + " is not an array");
+								}
+							} else if (known && target.array) {
+								report(scope, name, "array " + text(name) + " used without an index");
+							}
+							parser.expect("=");
+							if (!parser.failed) {
+								parser.value(known ? target.type : std::string());
+							}
+						}
+					} else if (parser.accept("call")) {
+						Token name;
+						if (parser.name(name)) {
+							parser.expect("(");
+							if (!parser.failed) {
+								parser.callStatement(name);
+							}
+						}
+					} else if (parser.accept("if")) {
+						parser.condition();
+						parser.expect("then");
+						blocks += 'i';
+					} else if (parser.accept("elseif")) {
+						if (blocks.empty() || blocks.back() != 'i') {
+							report(scope, token, "elseif without if");
+						}
+						parser.condition();
+						parser.expect("then");
+					} else if (parser.accept("else")) {
+						if (blocks.empty() || blocks.back() != 'i') {
+							report(scope, token, "else without if");
+						} else {
+							blocks.back() = 'e';
+						}
+					} else if (parser.accept("endif")) {
+						if (blocks.empty() || blocks.back() == 'l') {
+							report(scope, token, "endif without if");
+						} else {
+							blocks.pop_back();
+						}
+					} else if (parser.accept("loop")) {
+						blocks += 'l';
+					} else if (parser.accept("endloop")) {
+						if (blocks.empty() || blocks.back() != 'l') {
+							report(scope, token, "endloop without loop");
+						} else {
+							blocks.pop_back();
+						}
+					} else if (parser.accept("exitwhen")) {
+						if (blocks.find('l') == std::string::npos) {
+							report(scope, token, "exitwhen outside of a loop");
+						}
+						parser.condition();
+					} else if (parser.accept("return")) {
+						if (parser.peek().type == Jass::NEWLINE || parser.peek().type == Jass::END) {
+							if (function.returns != "nothing") {
+								report(scope, token, "missing return value, " + body.name + " returns " + function.returns);
+							}
+						} else if (function.returns == "nothing") {
+							report(scope, token, body.name + " returns nothing");
+							parser.expression();
+						} else {
+							returns = true;
+							parser.value(function.returns);
+						}
+					} else {
+						parser.skipLine();
+						report(scope, token, "unexpected " + text(token));
+					}
+				}
+
+				parser.endLine();
+			}
+
+			Token end = { Jass::IDENTIFIER, nullptr, 0, body.line };
+			if (!blocks.empty()) {
+				report(scope, end, blocks.back() == 'l' ? "missing endloop" : "missing endif");
+			}
+			if (function.returns != "nothing" && !returns) {
+				report(scope, end, "missing return in " + body.name);
+			}
+		} //check
+
+		void locate(Error& error) const {
+			auto segment = std::upper_bound(segments.begin(), segments.end(), error.line, [](uint32_t line, const Segment& segment) {
+				return line < segment.line;
+			});
+			if (segment != segments.begin()) {
+				--segment;
+				error.file = segment->file;
+				error.source = segment->source + (error.line - segment->line);
+			}
+		} //locate
+
+		//hide copy
+		JassChecker(const JassChecker&);
+		JassChecker& operator=(const JassChecker&);
+
+	public:
+		JassChecker() { }
+
+		//sets the output line to source mapping
+		void map(const std::vector<Segment>& value) {
+			segments = value;
+			std::stable_sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) { return a.line < b.line; });
+		} //map
+
+		//checks the code in [start, end), returns the errors ordered by line
+		std::vector<Error> check(const char* start, const char* end) {
+			Trace::Scope scope("jass", "check");
+
+			tokens.clear();
+			types.clear();
+			globals.clear();
+			functions.clear();
+			bodies.clear();
+
+			{
+				Trace::Scope scope("jass", "tokenize");
+				tokens = Jass::Lexer::tokenize(start, end);
+				tokens.erase(std::remove_if(tokens.begin(), tokens.end(), [](const Token& token) {
+					return token.type == Jass::COMMENT;
+				}), tokens.end());
+			}
+
+			Scope top;
+			for (auto& token : tokens) {
+				if (token.type == Jass::INVALID) {
+					report(top, token, "invalid token " + text(token));
+				}
+			}
+
+			{
+				Trace::Scope scope("jass", "declarations");
+				declarations(top);
+			}
+
+			std::vector<Scope> scopes(bodies.size());
+			ThreadPool::shared().forEach(bodies.size(), [&](size_t i) {
+				check(bodies[i], scopes[i]);
+			});
+
+			std::vector<Error> errors = top.errors;
+			for (auto& scope : scopes) {
+				errors.insert(errors.end(), scope.errors.begin(), scope.errors.end());
+			}
+			std::stable_sort(errors.begin(), errors.end(), [](const Error& a, const Error& b) { return a.line < b.line; });
+			for (auto& error : errors) {
+				locate(error);
+			}
+
+			return errors;
+		} //check
+}; //JassChecker
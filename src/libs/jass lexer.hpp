@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vector>
+#include <cctype>
+#include <cstring>
+#include <stdint.h>
+
+/*
+*	Jass::Lexer
+*
+*	Splits JASS source into tokens that point into the source, nothing is copied. Line
+*	breaks are tokens of their own since JASS statements end at them. Comments are
+*	returned as tokens so that passes rewriting the source can see them, checkers skip
+*	them.
+*/
+namespace Jass {
+	enum TokenType {
+		END,
+		NEWLINE,
+		COMMENT,
+		IDENTIFIER,		//keywords included
+		INTEGER,		//decimal, octal, hex (0x or $) and rawcodes ('A000')
+		REAL,
+		STRING,
+		OPERATOR,
+		INVALID,
+	};
+
+	struct Token {
+		TokenType type;
+		const char* start;
+		uint32_t size;
+		uint32_t line;		//1 based, line of the first character
+
+		bool is(const char* text) const {
+			return strlen(text) == size && memcmp(start, text, size) == 0;
+		} //is
+
+		bool is(char c) const { return size == 1 && *start == c; }
+	};
+
+	inline bool identifierStart(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+	inline bool identifierPart(char c) { return identifierStart(c) || (c >= '0' && c <= '9') || c == '_'; }
+	inline bool digit(char c) { return c >= '0' && c <= '9'; }
+
+	class Lexer {
+		private:
+			const char* at;
+			const char* end;
+			uint32_t line;
+
+			Token make(TokenType type, const char* start, uint32_t startLine) const {
+				Token token = { type, start, (uint32_t)(at - start), startLine };
+				return token;
+			} //make
+
+		public:
+			Lexer(const char* start, const char* end) : at(start), end(end), line(1) { }
+
+			Token next() {
+				while (at < end && (*at == ' ' || *at == '\t' || *at == '\r')) {
+					++at;
+				}
+
+				const char* start = at;
+				uint32_t startLine = line;
+
+				if (at >= end) {
+					return make(END, start, startLine);
+				}
+
+				char c = *at++;
+
+				if (c == '\n') {
+					++line;
+					return make(NEWLINE, start, startLine);
+				}
+
+				if (c == '/' && at < end && *at == '/') {
+					while (at < end && *at != '\n' && *at != '\r') {
+						++at;
+					}
+					return make(COMMENT, start, startLine);
+				}
+
+				if (identifierStart(c)) {
+					while (at < end && identifierPart(*at)) {
+						++at;
+					}
+					return make(IDENTIFIER, start, startLine);
+				}
+
+				if (digit(c) || (c == '.' && at < end && digit(*at))) {
+					if (c == '0' && at < end && (*at == 'x' || *at == 'X')) {
+						++at;
+						while (at < end && isxdigit((unsigned char)*at)) {
+							++at;
+						}
+						return make(INTEGER, start, startLine);
+					}
+
+					bool real = c == '.';
+					while (at < end && (digit(*at) || (*at == '.' && !real))) {
+						real = real || *at == '.';
+						++at;
+					}
+					return make(real ? REAL : INTEGER, start, startLine);
+				}
+
+				if (c == '$') {
+					while (at < end && isxdigit((unsigned char)*at)) {
+						++at;
+					}
+					return make(at - start > 1 ? INTEGER : INVALID, start, startLine);
+				}
+
+				if (c == '"' || c == '\'') {
+					while (at < end && *at != c) {
+						if (*at == '\\' && at + 1 < end) {
+							++at;
+						}
+						if (*at == '\n') {
+							++line;
+						}
+						++at;
+					}
+					if (at >= end) {
+						return make(INVALID, start, startLine);
+					}
+					++at;
+					return make(c == '"' ? STRING : INTEGER, start, startLine);
+				}
+
+				if ((c == '=' || c == '!' || c == '<' || c == '>') && at < end && *at == '=') {
+					++at;
+					return make(OPERATOR, start, startLine);
+				}
+
+				//strchr also finds the terminating zero, a NUL byte is INVALID
+				if (c != '\0' && strchr("=<>+-*/()[],", c) != nullptr) {
+					return make(OPERATOR, start, startLine);
+				}
+
+				return make(INVALID, start, startLine);
+			} //next
+
+			//every token up to and including END
+			static std::vector<Token> tokenize(const char* start, const char* end) {
+				std::vector<Token> tokens;
+				tokens.reserve((end - start) / 4);
+				Lexer lexer(start, end);
+				for (;;) {
+					tokens.push_back(lexer.next());
+					if (tokens.back().type == END) {
+						return tokens;
+					}
+				}
+			} //tokenize
+	}; //Lexer
+} //Jass
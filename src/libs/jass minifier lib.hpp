@@ -0,0 +1,95 @@
+#pragma once
+
+#include "luacpp.hpp"
+#include "luafile lib.hpp"
+#include "jass minifier.hpp"
+
+/*
+*	Lua access to JassMinifier (library "jass")
+*
+*		jass.minify(code [, options])	minified LuaFile of code (a LuaFile or a string)
+*
+*	options
+*
+*		rename = false		only strip comments and whitespace, the default renaming needs an
+*							open symbol database (symbols.open) to know the names of the game
+*		keep = { ... }		names that must not be renamed, e.g. functions run by name
+*		map = true			also return a table of new name = old name
+*
+*	for example
+*
+*		local small, names = jass.minify(output, { keep = { "InitCustomTriggers" }, map = true })
+*		small:dump("war3map.j")
+*/
+class JassMinifierLib {
+	private:
+		static int l_minify(Lua::State* L) {
+			Lua lua(L);
+
+			std::string code;
+			if (lua.type(1) == LUA_TSTRING) {
+				size_t size;
+				const char* s = lua.tolstring(1, &size);
+				code.assign(s, size);
+			} else {
+				code = LuaFileLib::check(lua, 1)->str();
+			}
+
+			JassMinifier minifier;
+			bool rename = true;
+			bool map = false;
+			if (lua.istable(2)) {
+				lua.getfield(2, "rename");
+				rename = lua.isnil(-1) || lua.toboolean(-1) != 0;
+				minifier.rename(rename);
+				lua.getfield(2, "map");
+				map = lua.toboolean(-1) != 0;
+				lua.pop(2);
+
+				lua.getfield(2, "keep");
+				if (lua.istable(-1)) {
+					for (int i = 1; ; ++i) {
+						lua.rawgeti(-1, i);
+						if (!lua.isstring(-1)) {
+							lua.pop(1);
+							break;
+						}
+						minifier.keep(lua.tostring(-1));
+						lua.pop(1);
+					}
+				}
+				lua.pop(1);
+			}
+
+			//without the database natives and common.j names would be renamed as if they were the code's own
+			if (rename && !JassSymbols::shared().isOpen()) {
+				return lua.l_error("jass.minify: no symbol database is open, call symbols.open or pass rename = false");
+			}
+
+			std::string out = minifier.run(code.data(), code.data() + code.size());
+			LuaFileLib::push(lua)->write(out.data(), out.size());
+
+			if (!map) {
+				return 1;
+			}
+
+			const std::vector<JassMinifier::Rename>& renames = minifier.renames();
+			lua.createtable(0, (int)renames.size());
+			for (auto& rename : renames) {
+				lua.pushlstring(rename.second.data(), rename.second.size());
+				lua.setfield(-2, rename.first.c_str());
+			}
+			return 2;
+		} //l_minify
+
+	public:
+		//adds to the "jass" library of JassCheckerLib when both are attached
+		static void attach(Lua& lua) {
+			static const Lua::l_Reg lib[] = {
+				{ "minify", l_minify },
+				{ nullptr, nullptr }
+			};
+			lua.l_register("jass", lib);
+			lua.pop(1);
+		} //attach
+}; //JassMinifierLib
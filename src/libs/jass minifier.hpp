@@ -0,0 +1,190 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "jass lexer.hpp"
+#include "jass symbols.hpp"
+#include "trace.hpp"
+
+/*
+*	JassMinifier
+*
+*	Shrinks generated JASS: comments, blank lines and whitespace that does not separate
+*	two tokens are dropped, and names declared by the code are replaced by the shortest
+*	free names, the most used names getting the shortest ones.
+*
+*	Two streaming passes over the tokens, the first counts names, the second copies
+*	token spans to the output. Names that are never renamed
+*
+*		keywords, names of the symbol database (natives, common.j and Blizzard.j)
+*		names declared by native in the input, which the game binds by name
+*		main and config, which the game calls
+*		names given to keep
+*		names that appear as a whole string literal ("name"), for ExecuteFunc and the like
+*
+*	Generated names never match a name of the input, so kept names cannot collide.
+*/
+class JassMinifier {
+	public:
+		typedef std::pair<std::string, std::string> Rename;	//new name, old name
+
+	private:
+		std::unordered_set<std::string> kept;
+		std::vector<Rename> renamed;
+		bool renaming;
+
+		static bool keyword(const Jass::Token& token) {
+			static const char* keywords[] = {
+				"and", "array", "call", "constant", "debug", "else", "elseif", "endfunction", "endglobals",
+				"endif", "endloop", "exitwhen", "extends", "false", "function", "globals", "if", "local",
+				"loop", "native", "not", "nothing", "null", "or", "return", "returns", "set", "takes",
+				"then", "true", "type", "integer", "real", "boolean", "string", "handle", "code",
+				nullptr
+			};
+			for (const char** keyword = keywords; *keyword != nullptr; ++keyword) {
+				if (token.is(*keyword)) {
+					return true;
+				}
+			}
+			return false;
+		} //keyword
+
+		//name number index, a-zA-Z then a-zA-Z0-9
+		static std::string generate(size_t index) {
+			static const char characters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+			std::string name(1, characters[index % 52]);
+			index /= 52;
+			while (index > 0) {
+				--index;
+				name += characters[index % 62];
+				index /= 62;
+			}
+			return name;
+		} //generate
+
+		//true if writing b right after a would change how the code is read
+		static bool joins(const Jass::Token& a, const Jass::Token& b) {
+			char last = a.start[a.size - 1];
+			char first = b.start[0];
+			if ((Jass::identifierPart(last) || last == '.') && (Jass::identifierPart(first) || first == '.' || first == '$')) {
+				return true;
+			}
+			return (last == '/' && first == '/') || (last == '-' && first == '-') || ((last == '=' || last == '<' || last == '>' || last == '!') && first == '=');
+		} //joins
+
+	public:
+		JassMinifier() : renaming(true) { }
+
+		void keep(const std::string& name) { kept.insert(name); }
+
+		void rename(bool value) { renaming = value; }
+
+		//new name, old name pairs of the last run
+		const std::vector<Rename>& renames() const { return renamed; }
+
+		//returns the minified code in [start, end)
+		std::string run(const char* start, const char* end) {
+			Trace::Scope scope("jass", "minify");
+
+			renamed.clear();
+			std::unordered_map<std::string, std::string> names;
+
+			if (renaming) {
+				std::unordered_map<std::string, size_t> counts;
+				std::unordered_set<std::string> strings;
+				std::unordered_set<std::string> types;
+				std::unordered_set<std::string> natives;
+
+				{
+					Trace::Scope scope("jass", "count names");
+					Jass::Lexer lexer(start, end);
+					bool type = false;
+					bool native = false;
+					for (Jass::Token token = lexer.next(); token.type != Jass::END; token = lexer.next()) {
+						if (token.type == Jass::STRING && token.size > 2) {
+							strings.insert(std::string(token.start + 1, token.size - 2));
+						} else if (token.type == Jass::IDENTIFIER) {
+							if (type) {
+								types.insert(std::string(token.start, token.size));
+							}
+							if (native) {
+								natives.insert(std::string(token.start, token.size));
+							}
+							type = token.is("type");
+							native = token.is("native");
+							++counts[std::string(token.start, token.size)];
+						} else if (token.type != Jass::COMMENT) {
+							type = false;
+							native = false;
+						}
+					}
+				}
+
+				const JassSymbols& symbols = JassSymbols::shared();
+				std::vector<std::pair<size_t, std::string>> candidates;
+				for (auto& count : counts) {
+					const std::string& name = count.first;
+					Jass::Token token = { Jass::IDENTIFIER, name.data(), (uint32_t)name.size(), 0 };
+					if (keyword(token) || name == "main" || name == "config" || kept.count(name) || strings.count(name) || types.count(name) || natives.count(name) || symbols.find(name) != nullptr) {
+						continue;
+					}
+					candidates.push_back(std::make_pair(count.second, name));
+				}
+				//most used first, by name for equal counts so that runs are repeatable
+				std::sort(candidates.begin(), candidates.end(), [](const std::pair<size_t, std::string>& a, const std::pair<size_t, std::string>& b) {
+					return a.first != b.first ? a.first > b.first : a.second < b.second;
+				});
+
+				size_t next = 0;
+				for (auto& candidate : candidates) {
+					std::string name;
+					for (;;) {
+						name = generate(next++);
+						Jass::Token token = { Jass::IDENTIFIER, name.data(), (uint32_t)name.size(), 0 };
+						if (!keyword(token) && !counts.count(name) && symbols.find(name) == nullptr) {
+							break;
+						}
+					}
+					if (name.size() >= candidate.second.size()) {
+						//later names are no shorter, give this one back
+						--next;
+						continue;
+					}
+					names[candidate.second] = name;
+					renamed.push_back(Rename(name, candidate.second));
+				}
+			}
+
+			Trace::Scope write("jass", "write");
+			std::string out;
+			out.reserve(end - start);
+
+			Jass::Lexer lexer(start, end);
+			Jass::Token previous = { Jass::NEWLINE, "\n", 1, 0 };
+			for (Jass::Token token = lexer.next(); token.type != Jass::END; token = lexer.next()) {
+				if (token.type == Jass::COMMENT || (token.type == Jass::NEWLINE && previous.type == Jass::NEWLINE)) {
+					continue;
+				}
+
+				if (token.type == Jass::IDENTIFIER && !names.empty()) {
+					auto name = names.find(std::string(token.start, token.size));
+					if (name != names.end()) {
+						token.start = name->second.data();
+						token.size = (uint32_t)name->second.size();
+					}
+				}
+
+				if (token.type != Jass::NEWLINE && previous.type != Jass::NEWLINE && joins(previous, token)) {
+					out += ' ';
+				}
+				out.append(token.start, token.size);
+				previous = token;
+			}
+
+			return out;
+		} //run
+}; //JassMinifier
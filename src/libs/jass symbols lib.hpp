@@ -0,0 +1,139 @@
+#pragma once
+
+#include "luacpp.hpp"
+#include "jass symbols.hpp"
+
+/*
+*	Lua access to JassSymbols (library "symbols")
+*
+*		symbols.open(path)					maps a database, true if one is open
+*		symbols.build(output, file, ...)	compiles JASS declarations, true or nil and the error
+*		symbols.find(name)					{ kind, name, type, constant, array, value, file, line, params } or nil
+*		symbols.kind(name)					"type", "native", "function", "global" or nil
+*		symbols.type(name)					return type, global type or parent type, or nil
+*		symbols.extends(type, base)			true if type is base or derives from it
+*
+*	params is a list of { type, name }. kind and type do not build tables, use them for
+*	checks in loops.
+*/
+class JassSymbolsLib {
+	private:
+		static int l_open(Lua::State* L) {
+			Lua lua(L);
+			lua.pushboolean(JassSymbols::shared().open(lua.l_checkstring(1)));
+			return 1;
+		} //l_open
+
+		static int l_build(Lua::State* L) {
+			Lua lua(L);
+			std::string output = lua.l_checkstring(1);
+			std::vector<std::string> files;
+			for (int i = 2; i <= lua.gettop(); ++i) {
+				files.push_back(lua.l_checkstring(i));
+			}
+
+			std::string error = JassSymbols::build(files, output);
+			if (!error.empty()) {
+				lua.pushnil();
+				lua.pushlstring(error.data(), error.size());
+				return 2;
+			}
+
+			lua.pushboolean(true);
+			return 1;
+		} //l_build
+
+		static const JassSymbols::Symbol* check(Lua& lua) {
+			size_t size;
+			const char* name = lua.l_checklstring(1, &size);
+			return JassSymbols::shared().find(name, size);
+		} //check
+
+		static int l_find(Lua::State* L) {
+			Lua lua(L);
+			const JassSymbols::Symbol* symbol = check(lua);
+			if (symbol == nullptr) {
+				lua.pushnil();
+				return 1;
+			}
+
+			JassSymbols& symbols = JassSymbols::shared();
+			lua.createtable(0, 9);
+			lua.pushstring(JassSymbols::kindName(symbol->kind));
+			lua.setfield(-2, "kind");
+			lua.pushstring(symbols.string(symbol->name));
+			lua.setfield(-2, "name");
+			lua.pushstring(symbols.string(symbol->type));
+			lua.setfield(-2, "type");
+			lua.pushboolean((symbol->flags & JassSymbols::CONSTANT) != 0);
+			lua.setfield(-2, "constant");
+			lua.pushboolean((symbol->flags & JassSymbols::ARRAY) != 0);
+			lua.setfield(-2, "array");
+			if (symbol->value != 0) {
+				lua.pushstring(symbols.string(symbol->value));
+				lua.setfield(-2, "value");
+			}
+			lua.pushstring(symbols.string(symbol->source));
+			lua.setfield(-2, "file");
+			lua.pushnumber((Lua::Number)symbol->line);
+			lua.setfield(-2, "line");
+
+			if (symbol->kind == JassSymbols::NATIVE || symbol->kind == JassSymbols::FUNCTION) {
+				lua.createtable((int)symbol->count, 0);
+				for (uint32_t i = 0; i < symbol->count; ++i) {
+					lua.createtable(0, 2);
+					lua.pushstring(symbols.paramType(*symbol, i));
+					lua.setfield(-2, "type");
+					lua.pushstring(symbols.paramName(*symbol, i));
+					lua.setfield(-2, "name");
+					lua.rawseti(-2, (int)i + 1);
+				}
+				lua.setfield(-2, "params");
+			}
+
+			return 1;
+		} //l_find
+
+		static int l_kind(Lua::State* L) {
+			Lua lua(L);
+			const JassSymbols::Symbol* symbol = check(lua);
+			if (symbol == nullptr) {
+				lua.pushnil();
+			} else {
+				lua.pushstring(JassSymbols::kindName(symbol->kind));
+			}
+			return 1;
+		} //l_kind
+
+		static int l_type(Lua::State* L) {
+			Lua lua(L);
+			const JassSymbols::Symbol* symbol = check(lua);
+			if (symbol == nullptr) {
+				lua.pushnil();
+			} else {
+				lua.pushstring(JassSymbols::shared().string(symbol->type));
+			}
+			return 1;
+		} //l_type
+
+		static int l_extends(Lua::State* L) {
+			Lua lua(L);
+			lua.pushboolean(JassSymbols::shared().extends(lua.l_checkstring(1), lua.l_checkstring(2)));
+			return 1;
+		} //l_extends
+
+	public:
+		static void attach(Lua& lua) {
+			static const Lua::l_Reg lib[] = {
+				{ "open", l_open },
+				{ "build", l_build },
+				{ "find", l_find },
+				{ "kind", l_kind },
+				{ "type", l_type },
+				{ "extends", l_extends },
+				{ nullptr, nullptr }
+			};
+			lua.l_register("symbols", lib);
+			lua.pop(1);
+		} //attach
+}; //JassSymbolsLib
@@ -0,0 +1,528 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <stdint.h>
+
+#include "mapped file.hpp"
+#include "trace.hpp"
+
+/*
+*	JassSymbols
+*
+*	Declarations of common.j and Blizzard.j (types, natives, functions and globals)
+*	compiled into a binary database that is memory mapped and queried in place. Names
+*	are found through a perfect hash (hash and displace), so a lookup is two hashes and
+*	one string compare whatever the number of symbols.
+*
+*	Layout, all fields uint32, offsets from the start of the file
+*
+*		Header
+*		Symbol[count]
+*		displacement[buckets]		hash seed of each bucket
+*		slot[count]					symbol index of each hash slot
+*		param[]						pairs of type, name string offsets
+*		strings						zero terminated
+*
+*	Compile a database with build and open it once at startup, before any thread uses
+*	shared(). open checks that every table lies within the file and that the strings end
+*	with a zero, string and param offsets past their tables read as empty strings, so a
+*	truncated or corrupt database is refused or answers with empty names.
+*/
+class JassSymbols {
+	public:
+		enum Kind {
+			TYPE = 1,
+			NATIVE = 2,
+			FUNCTION = 3,
+			GLOBAL = 4,
+		};
+
+		enum Flags {
+			CONSTANT = 1,
+			ARRAY = 2,
+		};
+
+		struct Symbol {
+			uint32_t kind;
+			uint32_t flags;
+			uint32_t name;
+			uint32_t type;		//return type, value type, or parent type of a type
+			uint32_t params;	//index of the first param pair
+			uint32_t count;		//number of params
+			uint32_t value;		//initial value of a global, 0 if none
+			uint32_t source;	//file name
+			uint32_t line;
+		};
+
+	private:
+		struct Header {
+			char magic[4];
+			uint32_t version;
+			uint32_t count;
+			uint32_t buckets;
+			uint32_t symbols;
+			uint32_t displacements;
+			uint32_t slots;
+			uint32_t params;
+			uint32_t strings;
+			uint32_t size;
+		};
+
+		static const uint32_t VERSION = 1;
+
+		MappedFile file;
+		const Header* header;
+		uint32_t stringBytes;	//size of the strings block
+		uint32_t paramCount;	//number of type, name pairs
+		std::atomic<bool> ready;
+		std::mutex lock;
+
+		static uint32_t hash(const char* s, size_t size, uint32_t seed) {
+			uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+			for (size_t i = 0; i < size; ++i) {
+				h = (h ^ (unsigned char)s[i]) * 16777619u;
+			}
+			h ^= h >> 16;
+			h *= 0x85ebca6bu;
+			h ^= h >> 13;
+			h *= 0xc2b2ae35u;
+			h ^= h >> 16;
+			return h;
+		} //hash
+
+		const uint32_t* table(uint32_t offset) const { return (const uint32_t*)(file.data() + offset); }
+
+		//true if the table of count entries of size bytes at offset lies within the file
+		static bool fits(const Header& header, uint32_t offset, uint64_t count, uint64_t size) {
+			return offset % 4 == 0 && offset <= header.size && count * size <= header.size - offset;
+		} //fits
+
+		//field (0 type, 1 name) of param i of symbol
+		const char* param(const Symbol& symbol, uint32_t i, uint32_t field) const {
+			uint64_t pair = (uint64_t)symbol.params + i;
+			return pair < paramCount ? string(table(header->params)[pair * 2 + field]) : "";
+		} //param
+
+		/*
+		*	Builder
+		*
+		*	Reads the declarations of JASS files line by line. Function bodies are skipped.
+		*/
+		class Builder {
+			private:
+				struct Entry {
+					Symbol symbol;
+					std::vector<std::pair<std::string, std::string>> params;
+					std::string name;
+					std::string type;
+					std::string value;
+					std::string source;
+				};
+
+				std::vector<Entry> entries;
+				std::string strings;
+				std::unordered_map<std::string, uint32_t> interned;
+
+				static std::vector<std::string> split(const std::string& s, const char* separators) {
+					std::vector<std::string> tokens;
+					size_t start = s.find_first_not_of(separators);
+					while (start != std::string::npos) {
+						size_t end = s.find_first_of(separators, start);
+						tokens.push_back(s.substr(start, end == std::string::npos ? end : end - start));
+						start = end == std::string::npos ? end : s.find_first_not_of(separators, end);
+					}
+					return tokens;
+				} //split
+
+				//removes a // comment that is not inside a string literal
+				static void uncomment(std::string& line) {
+					bool quoted = false;
+					for (size_t i = 0; i + 1 < line.size(); ++i) {
+						if (line[i] == '\\' && quoted) {
+							++i;
+						} else if (line[i] == '"') {
+							quoted = !quoted;
+						} else if (!quoted && line[i] == '/' && line[i + 1] == '/') {
+							line.erase(i);
+							return;
+						}
+					}
+				} //uncomment
+
+				//name takes a b, c d returns r
+				bool signature(const std::string& line, size_t start, Entry& entry) {
+					size_t takes = line.find(" takes ", start);
+					size_t returns = line.find(" returns ", start);
+					if (takes == std::string::npos || returns == std::string::npos || returns < takes) {
+						return false;
+					}
+
+					std::vector<std::string> name = split(line.substr(start, takes - start), " \t");
+					std::vector<std::string> type = split(line.substr(returns + 9), " \t");
+					if (name.size() != 1 || type.size() != 1) {
+						return false;
+					}
+					entry.name = name[0];
+					entry.type = type[0];
+
+					std::vector<std::string> params = split(line.substr(takes + 7, returns - takes - 7), ",");
+					for (auto& param : params) {
+						std::vector<std::string> parts = split(param, " \t");
+						if (parts.size() == 2) {
+							entry.params.push_back(std::make_pair(parts[0], parts[1]));
+						} else if (!(parts.size() == 1 && parts[0] == "nothing")) {
+							return false;
+						}
+					}
+
+					return true;
+				} //signature
+
+				uint32_t intern(const std::string& s) {
+					if (s.empty()) {
+						return 0;
+					}
+					auto found = interned.find(s);
+					if (found != interned.end()) {
+						return found->second;
+					}
+					uint32_t offset = (uint32_t)strings.size();
+					strings.append(s.c_str(), s.size() + 1);
+					interned[s] = offset;
+					return offset;
+				} //intern
+
+			public:
+				std::string failure;
+
+				bool read(const std::string& filename) {
+					Trace::Scope scope("symbols", "read", filename.c_str());
+
+					std::ifstream in(filename.c_str(), std::ios::binary);
+					if (!in.is_open()) {
+						failure = "cannot open " + filename;
+						return false;
+					}
+
+					bool globals = false;
+					bool function = false;
+					uint32_t number = 0;
+
+					std::string line;
+					while (std::getline(in, line)) {
+						++number;
+						uncomment(line);
+						if (!line.empty() && line.back() == '\r') {
+							line.pop_back();
+						}
+
+						std::vector<std::string> tokens = split(line, " \t");
+						if (tokens.empty()) {
+							continue;
+						}
+
+						Entry entry;
+						memset(&entry.symbol, 0, sizeof(entry.symbol));
+						entry.symbol.line = number;
+						entry.source = filename;
+
+						const std::string& first = tokens[0];
+						if (function) {
+							function = first != "endfunction";
+							continue;
+						} else if (first == "globals") {
+							globals = true;
+							continue;
+						} else if (first == "endglobals") {
+							globals = false;
+							continue;
+						} else if (globals) {
+							//[constant] type [array] name [= value]
+							size_t at = 0;
+							entry.symbol.kind = GLOBAL;
+							if (tokens[at] == "constant") {
+								entry.symbol.flags |= CONSTANT;
+								++at;
+							}
+							if (at + 1 >= tokens.size()) {
+								failure = filename + ":" + std::to_string(number) + ": bad global";
+								return false;
+							}
+							entry.type = tokens[at++];
+							if (tokens[at] == "array" && at + 1 < tokens.size()) {
+								entry.symbol.flags |= ARRAY;
+								++at;
+							}
+							entry.name = tokens[at].substr(0, tokens[at].find('='));
+							size_t equals = line.find('=');
+							if (equals != std::string::npos) {
+								size_t start = line.find_first_not_of(" \t", equals + 1);
+								size_t end = line.find_last_not_of(" \t");
+								entry.value = start == std::string::npos ? "" : line.substr(start, end - start + 1);
+							}
+						} else if (first == "type" && tokens.size() == 4 && tokens[2] == "extends") {
+							entry.symbol.kind = TYPE;
+							entry.name = tokens[1];
+							entry.type = tokens[3];
+						} else if (first == "native" || (first == "constant" && tokens.size() > 1 && tokens[1] == "native")) {
+							entry.symbol.kind = NATIVE;
+							entry.symbol.flags = first == "constant" ? CONSTANT : 0;
+							if (!signature(line, line.find("native") + 6, entry)) {
+								failure = filename + ":" + std::to_string(number) + ": bad native";
+								return false;
+							}
+						} else if (first == "function" || (first == "constant" && tokens.size() > 1 && tokens[1] == "function")) {
+							entry.symbol.kind = FUNCTION;
+							entry.symbol.flags = first == "constant" ? CONSTANT : 0;
+							if (!signature(line, line.find("function") + 8, entry)) {
+								failure = filename + ":" + std::to_string(number) + ": bad function";
+								return false;
+							}
+							function = true;
+						} else {
+							continue;
+						}
+
+						entries.push_back(entry);
+					}
+
+					return true;
+				} //read
+
+				bool write(const std::string& filename) {
+					Trace::Scope scope("symbols", "write", filename.c_str());
+
+					//first declaration of a name wins
+					std::vector<Entry> unique;
+					{
+						std::unordered_map<std::string, bool> added;
+						for (auto& entry : entries) {
+							if (!added[entry.name]) {
+								added[entry.name] = true;
+								unique.push_back(entry);
+							}
+						}
+					}
+
+					uint32_t count = (uint32_t)unique.size();
+					uint32_t buckets = count / 4 + 1;
+					uint32_t slotCount = count > 0 ? count : 1;
+
+					//offset 0 of the strings is the empty string
+					strings.assign(1, '\0');
+
+					std::vector<Symbol> symbols;
+					std::vector<uint32_t> params;
+					for (auto& entry : unique) {
+						Symbol symbol = entry.symbol;
+						symbol.name = intern(entry.name);
+						symbol.type = intern(entry.type);
+						symbol.params = (uint32_t)(params.size() / 2);
+						symbol.count = (uint32_t)entry.params.size();
+						for (auto& param : entry.params) {
+							params.push_back(intern(param.first));
+							params.push_back(intern(param.second));
+						}
+						symbol.source = intern(entry.source);
+						symbol.value = intern(entry.value);
+						symbols.push_back(symbol);
+					}
+
+					//hash and displace: place the largest buckets first, find a seed that sends all their names to free slots
+					std::vector<std::vector<uint32_t>> members(buckets);
+					for (uint32_t i = 0; i < count; ++i) {
+						members[hash(unique[i].name.data(), unique[i].name.size(), 0) % buckets].push_back(i);
+					}
+					std::vector<uint32_t> order(buckets);
+					for (uint32_t i = 0; i < buckets; ++i) {
+						order[i] = i;
+					}
+					std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return members[a].size() > members[b].size(); });
+
+					std::vector<uint32_t> displacements(buckets, 0);
+					std::vector<uint32_t> slots(slotCount, 0xFFFFFFFFu);
+					std::vector<uint32_t> taken;
+					for (auto bucket : order) {
+						if (members[bucket].empty()) {
+							break;
+						}
+
+						bool placed = false;
+						for (uint32_t seed = 1; seed < (1u << 24) && !placed; ++seed) {
+							taken.clear();
+							placed = true;
+							for (auto i : members[bucket]) {
+								uint32_t slot = hash(unique[i].name.data(), unique[i].name.size(), seed) % slotCount;
+								if (slots[slot] != 0xFFFFFFFFu || std::find(taken.begin(), taken.end(), slot) != taken.end()) {
+									placed = false;
+									break;
+								}
+								taken.push_back(slot);
+							}
+							if (placed) {
+								displacements[bucket] = seed;
+								for (size_t j = 0; j < taken.size(); ++j) {
+									slots[taken[j]] = members[bucket][j];
+								}
+							}
+						}
+
+						if (!placed) {
+							failure = "cannot build the name table";
+							return false;
+						}
+					}
+
+					Header header;
+					memcpy(header.magic, "JSDB", 4);
+					header.version = VERSION;
+					header.count = count;
+					header.buckets = buckets;
+					header.symbols = sizeof(Header);
+					header.displacements = header.symbols + count * sizeof(Symbol);
+					header.slots = header.displacements + buckets * 4;
+					header.params = header.slots + slotCount * 4;
+					header.strings = header.params + (uint32_t)params.size() * 4;
+					header.size = header.strings + (uint32_t)strings.size();
+
+					std::ofstream out(filename.c_str(), std::ios::binary);
+					out.write((const char*)&header, sizeof(header));
+					out.write((const char*)symbols.data(), symbols.size() * sizeof(Symbol));
+					out.write((const char*)displacements.data(), displacements.size() * 4);
+					out.write((const char*)slots.data(), slots.size() * 4);
+					out.write((const char*)params.data(), params.size() * 4);
+					out.write(strings.data(), strings.size());
+					if (!out) {
+						failure = "cannot write " + filename;
+						return false;
+					}
+
+					return true;
+				} //write
+		}; //Builder
+
+		//hide copy
+		JassSymbols(const JassSymbols&);
+		JassSymbols& operator=(const JassSymbols&);
+
+	public:
+		JassSymbols() : header(nullptr), stringBytes(0), paramCount(0), ready(false) { }
+
+		static JassSymbols& shared() {
+			static JassSymbols symbols;
+			return symbols;
+		} //shared
+
+		//compiles the declarations of files into a database, returns an empty string or the error
+		static std::string build(const std::vector<std::string>& files, const std::string& output) {
+			Builder builder;
+			for (auto& file : files) {
+				if (!builder.read(file)) {
+					return builder.failure;
+				}
+			}
+			return builder.write(output) ? std::string() : builder.failure;
+		} //build
+
+		//maps a database, does nothing if one is already open
+		bool open(const char* filename) {
+			std::lock_guard<std::mutex> guard(lock);
+			if (ready) {
+				return true;
+			}
+
+			Trace::Scope scope("symbols", "open", filename);
+			if (!file.open(filename) || file.size() < sizeof(Header)) {
+				file.close();
+				return false;
+			}
+
+			const Header* mapped = (const Header*)file.data();
+			if (memcmp(mapped->magic, "JSDB", 4) != 0 || mapped->version != VERSION || mapped->size != file.size() || mapped->buckets == 0) {
+				file.close();
+				return false;
+			}
+
+			//the params run up to the strings, which run to the end of the file
+			const Header& h = *mapped;
+			if (!fits(h, h.symbols, h.count, sizeof(Symbol)) || !fits(h, h.displacements, h.buckets, 4) || !fits(h, h.slots, h.count > 0 ? h.count : 1, 4) ||
+				!fits(h, h.params, 0, 0) || h.strings < h.params || (h.strings - h.params) % 8 != 0 || h.strings >= h.size || file.data()[h.size - 1] != '\0')
+			{
+				file.close();
+				return false;
+			}
+
+			stringBytes = h.size - h.strings;
+			paramCount = (h.strings - h.params) / 8;
+			header = mapped;
+			ready = true;
+			return true;
+		} //open
+
+		bool isOpen() const { return ready; }
+
+		size_t size() const { return ready ? header->count : 0; }
+
+		//symbol called name, or null
+		const Symbol* find(const char* name, size_t size) const {
+			if (!ready || header->count == 0) {
+				return nullptr;
+			}
+
+			uint32_t seed = table(header->displacements)[hash(name, size, 0) % header->buckets];
+			if (seed == 0) {
+				return nullptr;
+			}
+			uint32_t index = table(header->slots)[hash(name, size, seed) % header->count];
+			if (index >= header->count) {
+				return nullptr;
+			}
+
+			const Symbol* symbol = (const Symbol*)(file.data() + header->symbols) + index;
+			const char* candidate = string(symbol->name);
+			return strlen(candidate) == size && memcmp(candidate, name, size) == 0 ? symbol : nullptr;
+		} //find
+
+		const Symbol* find(const std::string& name) const { return find(name.data(), name.size()); }
+
+		//string at offset of the strings block, empty if offset is past it
+		const char* string(uint32_t offset) const { return offset < stringBytes ? file.data() + header->strings + offset : ""; }
+
+		//type and name of param i of a native or function, empty if the pair is past the params
+		const char* paramType(const Symbol& symbol, uint32_t i) const { return param(symbol, i, 0); }
+		const char* paramName(const Symbol& symbol, uint32_t i) const { return param(symbol, i, 1); }
+
+		//true if type is base or extends it, directly or not
+		bool extends(const std::string& type, const std::string& base) const {
+			std::string current = type;
+			for (int depth = 0; depth < 64; ++depth) {
+				if (current == base) {
+					return true;
+				}
+				const Symbol* symbol = find(current);
+				if (symbol == nullptr || symbol->kind != TYPE) {
+					return false;
+				}
+				current = string(symbol->type);
+			}
+			return false;
+		} //extends
+
+		static const char* kindName(uint32_t kind) {
+			switch (kind) {
+				case TYPE: return "type";
+				case NATIVE: return "native";
+				case FUNCTION: return "function";
+				case GLOBAL: return "global";
+				default: return "unknown";
+			}
+		} //kindName
+}; //JassSymbols
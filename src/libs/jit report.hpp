@@ -0,0 +1,307 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <ostream>
+
+#include "luacpp.hpp"
+
+/*
+*	JitReport
+*
+*	Collects LuaJIT trace events (start, stop, abort, flush) through jit.attach and
+*	summarizes the loops whose traces abort most often, with the abort reasons.
+*
+*	Requires the jit.util and jit.vmdef modules that ship with LuaJIT.
+*/
+class JitReport {
+	private:
+		struct Abort {
+			size_t count;
+			std::map<std::string, size_t> reasons;
+
+			Abort() : count(0) { }
+		};
+
+		size_t started;
+		size_t stopped;
+		size_t aborted;
+		size_t flushed;
+
+		//start location of each trace in flight, aborts are charged to the loop that started it
+		std::map<int, std::string> active;
+		std::map<std::string, Abort> aborts;
+
+		//pushes "source:line" for func, pc at index
+		static std::string location(Lua& lua, int func, int pc) {
+			std::string loc = "?";
+
+			lua.pushvalue(lua.upvalueindex(2));
+			lua.getfield(-1, "funcinfo");
+			lua.pushvalue(func);
+			lua.pushvalue(pc);
+			if (lua.pcall(2, 1, 0) == 0 && lua.istable(-1)) {
+				lua.getfield(-1, "loc");
+				if (lua.isstring(-1)) {
+					loc = lua.tostring(-1);
+				}
+				lua.pop(1);
+			}
+			lua.pop(2);
+
+			return loc;
+		} //location
+
+		//formats the abort reason from jit.vmdef.traceerr
+		static std::string reason(Lua& lua, int otr, int oex) {
+			std::string message;
+
+			lua.pushvalue(lua.upvalueindex(3));
+			lua.pushvalue(otr);
+			lua.gettable(-2);
+			message = lua.isstring(-1) ? lua.tostring(-1) : "unknown";
+			lua.pop(2);
+
+			size_t pos = message.find('%');
+			if (pos != std::string::npos && pos + 1 < message.size()) {
+				std::string value;
+				if (lua.type(oex) == LUA_TNUMBER || lua.type(oex) == LUA_TSTRING) {
+					value = lua.tostring(oex);
+				} else {
+					value = lua.l_typename(oex);
+				}
+				message.replace(pos, 2, value);
+			}
+
+			return message;
+		} //reason
+
+		//jit.attach callback: what, tr, func, pc, otr, oex
+		static int onTrace(Lua::State* L) {
+			Lua lua(L);
+			JitReport& report = *(JitReport*)lua.touserdata(lua.upvalueindex(1));
+
+			std::string what = lua.l_optstring(1, "");
+			int trace = lua.l_optint(2, 0);
+
+			if (what == "start") {
+				++report.started;
+				report.active[trace] = location(lua, 3, 4);
+			} else if (what == "stop") {
+				++report.stopped;
+				report.active.erase(trace);
+			} else if (what == "abort") {
+				++report.aborted;
+				std::string loop = report.active.count(trace) ? report.active[trace] : location(lua, 3, 4);
+				Abort& abort = report.aborts[loop];
+				++abort.count;
+				++abort.reasons[reason(lua, 5, 6) + " at " + location(lua, 3, 4)];
+				report.active.erase(trace);
+			} else if (what == "flush") {
+				++report.flushed;
+				report.active.clear();
+			}
+
+			return 0;
+		} //onTrace
+
+		//calls require(name), leaving the result on the stack, returns false on failure
+		static bool require(Lua& lua, const char* name) {
+			lua.getglobal("require");
+			lua.pushstring(name);
+			if (lua.pcall(1, 1, 0) != 0) {
+				lua.pop(1);
+				return false;
+			}
+			return true;
+		} //require
+
+	public:
+		JitReport() : started(0), stopped(0), aborted(0), flushed(0) { }
+
+		//registers the trace handler with the state, returns false when the state has no JIT
+		bool attach(Lua& lua) {
+			int top = lua.gettop();
+
+			if (!require(lua, "jit") || !lua.istable(-1)) {
+				lua.settop(top);
+				return false;
+			}
+			int jit = lua.gettop();
+
+			if (!require(lua, "jit.util") || !require(lua, "jit.vmdef")) {
+				lua.settop(top);
+				return false;
+			}
+			lua.getfield(-1, "traceerr");
+			lua.remove(-2);
+
+			lua.getfield(jit, "attach");
+			lua.insert(jit + 1);
+			lua.pushlightuserdata(this);
+			lua.insert(jit + 2);
+			lua.pushccloser(onTrace, 3);
+			lua.pushstring("trace");
+			bool ok = lua.pcall(2, 0, 0) == 0;
+
+			lua.settop(top);
+			return ok;
+		} //attach
+
+		//writes totals and the most often aborted loops
+		void print(std::ostream& out, size_t limit = 10) const {
+			out << "-- jit: " << started << " traces started, " << stopped << " completed, " << aborted << " aborted, " << flushed << " flushes" << std::endl;
+
+			std::vector<std::pair<size_t, std::string>> hottest;
+			for (auto& abort : aborts) {
+				hottest.push_back(std::make_pair(abort.second.count, abort.first));
+			}
+			std::sort(hottest.begin(), hottest.end(), [](const std::pair<size_t, std::string>& a, const std::pair<size_t, std::string>& b) {
+				return a.first > b.first;
+			});
+			if (hottest.size() > limit) {
+				hottest.resize(limit);
+			}
+
+			for (auto& loop : hottest) {
+				out << "-- " << loop.first << " aborts in loop at " << loop.second << std::endl;
+				for (auto& reason : aborts.find(loop.second)->second.reasons) {
+					out << "--\t" << reason.second << "x " << reason.first << std::endl;
+				}
+			}
+		} //print
+}; //JitReport
+
+/*
+*	JitPolicy
+*
+*	Per module JIT modes (on, off, flush) applied with Lua::setmode to each module chunk
+*	as require loads it. A module without its own entry uses the entry of its closest
+*	parent ("a.b.c" falls back to "a.b", then "a"). The entry "*" sets the engine mode
+*	and the script run by makefile is the module "main".
+*
+*	The configuration is a Lua file returning a table, for example
+*
+*		return { ["*"] = "on", ["tokenizer"] = "off", ["libs.expand"] = "flush" }
+*
+*	Any other mode is an error, a misspelled mode does not quietly turn the JIT on.
+*/
+class JitPolicy {
+	private:
+		std::map<std::string, int> modes;
+
+		//mode flag of a mode name, or -1 for an unknown name
+		static int parse(const std::string& mode) {
+			if (mode == "on") return LUAJIT_MODE_ON;
+			if (mode == "off") return LUAJIT_MODE_OFF;
+			if (mode == "flush") return LUAJIT_MODE_FLUSH;
+			return -1;
+		} //parse
+
+		//returns the mode flag for a module, or -1 if none applies
+		int find(std::string name) const {
+			for (;;) {
+				auto mode = modes.find(name);
+				if (mode != modes.end()) {
+					return mode->second;
+				}
+
+				size_t dot = name.find_last_of('.');
+				if (dot == std::string::npos) {
+					return -1;
+				}
+				name.erase(dot);
+			}
+		} //find
+
+		//wraps a package.loaders entry: name -> loader, applying the module mode to the loader
+		static int loader(Lua::State* L) {
+			Lua lua(L);
+			JitPolicy& policy = *(JitPolicy*)lua.touserdata(lua.upvalueindex(1));
+			const char* name = lua.l_checkstring(1);
+
+			lua.pushvalue(lua.upvalueindex(2));
+			lua.insert(1);
+			lua.call(lua.gettop() - 1, LUA_MULTRET);
+
+			if (lua.isfunction(1)) {
+				int mode = policy.find(name);
+				if (mode != -1) {
+					lua.setmode(1, LUAJIT_MODE_ALLFUNC | mode);
+				}
+			}
+
+			return lua.gettop();
+		} //loader
+
+	public:
+		//returns false for an unknown mode
+		bool set(const std::string& module, const std::string& mode) {
+			int flag = parse(mode);
+			if (flag == -1) {
+				return false;
+			}
+			modes[module] = flag;
+			return true;
+		} //set
+
+		//reads a policy file, returns false and leaves the error message on the stack on failure
+		bool load(Lua& lua, const char* filename) {
+			if (lua.l_loadfile(filename) != 0 || lua.pcall(0, 1, 0) != 0) {
+				return false;
+			}
+
+			if (lua.istable(-1)) {
+				lua.pushnil();
+				while (lua.next(-2)) {
+					if (lua.type(-2) == LUA_TSTRING && lua.isstring(-1) && !set(lua.tostring(-2), lua.tostring(-1))) {
+						std::string module = lua.tostring(-2);
+						std::string mode = lua.tostring(-1);
+						lua.pop(3);
+						lua.pushfstring("%s: unknown JIT mode \"%s\" for %s (on, off or flush)", filename, mode.c_str(), module.c_str());
+						return false;
+					}
+					lua.pop(1);
+				}
+			}
+			lua.pop(1);
+
+			return true;
+		} //load
+
+		//sets the engine mode and wraps the package loaders of the state
+		void apply(Lua& lua) {
+			auto engine = modes.find("*");
+			if (engine != modes.end()) {
+				lua.setmode(0, LUAJIT_MODE_ENGINE | engine->second);
+			}
+
+			lua.getglobal("package");
+			lua.getfield(-1, "loaders");
+			if (lua.istable(-1)) {
+				int loaders = lua.gettop();
+				for (int i = 1; ; ++i) {
+					lua.rawgeti(loaders, i);
+					if (lua.isnil(-1)) {
+						lua.pop(1);
+						break;
+					}
+					lua.pushlightuserdata(this);
+					lua.insert(-2);
+					lua.pushccloser(loader, 2);
+					lua.rawseti(loaders, i);
+				}
+			}
+			lua.pop(2);
+		} //apply
+
+		//applies the mode for name to the function at index
+		void apply(Lua& lua, int index, const std::string& name) const {
+			int mode = find(name);
+			if (mode != -1) {
+				lua.setmode(index, LUAJIT_MODE_ALLFUNC | mode);
+			}
+		} //apply
+}; //JitPolicy
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <condition_variable>
+
+#include "process.hpp"
+
+/*
+*	JobRunner
+*
+*	Runs external commands with make -j semantics: up to limit commands at once, each
+*	started once every job it depends on has succeeded. A job whose dependency failed or
+*	was skipped is skipped, and unless keepGoing is set no new jobs start after a failure.
+*
+*	Completions are reported on the thread calling run, in the order jobs finish, so the
+*	callback can safely call back into a Lua state. It may add jobs; jobs are held by
+*	pointer and workers only touch their own job, so adding never moves a job that a
+*	worker is writing to.
+*/
+class JobRunner {
+	public:
+		enum State {
+			WAITING,
+			RUNNING,
+			SUCCEEDED,
+			FAILED,
+			SKIPPED
+		};
+
+		struct Job {
+			std::string command;
+			std::vector<size_t> deps;
+			State state;
+			Process::Result result;
+		};
+
+	private:
+		std::vector<std::unique_ptr<Job>> jobs;
+
+		std::mutex lock;
+		std::condition_variable completed;
+		std::deque<size_t> finished;
+
+	public:
+		//returns the id of the job, deps are ids of jobs added before or after
+		size_t add(const std::string& command, const std::vector<size_t>& deps) {
+			Job* job = new Job();
+			job->command = command;
+			job->deps = deps;
+			job->state = WAITING;
+			jobs.push_back(std::unique_ptr<Job>(job));
+			return jobs.size() - 1;
+		} //add
+
+		Job& job(size_t id) { return *jobs[id]; }
+		size_t size() const { return jobs.size(); }
+
+		//runs every waiting job, returns the number that failed or were skipped
+		//done(id) is called as each job finishes, returning false stops starting new jobs
+		size_t run(size_t limit, bool keepGoing, const std::function<bool(size_t)>& done) {
+			if (limit == 0) {
+				limit = 1;
+			}
+
+			std::vector<std::thread> threads;
+			size_t running = 0;
+			size_t failures = 0;
+			bool stopping = false;
+
+			for (;;) {
+				//skip jobs that can no longer run, start those that are ready
+				bool progressed = true;
+				while (progressed) {
+					progressed = false;
+					for (size_t id = 0; id < jobs.size(); ++id) {
+						Job& job = *jobs[id];
+						if (job.state != WAITING) {
+							continue;
+						}
+
+						bool ready = true;
+						bool blocked = false;
+						for (auto dep : job.deps) {
+							State state = dep < jobs.size() ? jobs[dep]->state : SKIPPED;
+							ready = ready && state == SUCCEEDED;
+							blocked = blocked || state == FAILED || state == SKIPPED;
+						}
+
+						if (blocked || (stopping && ready)) {
+							job.state = SKIPPED;
+							++failures;
+							progressed = true;
+							if (!done(id)) {
+								stopping = true;
+							}
+						} else if (ready && running < limit) {
+							job.state = RUNNING;
+							++running;
+							Job* started = &job;
+							threads.push_back(std::thread([this, started, id] {
+								started->result = Process::run(started->command);
+
+								std::lock_guard<std::mutex> guard(lock);
+								finished.push_back(id);
+								completed.notify_one();
+							}));
+						}
+					}
+				}
+
+				if (running == 0) {
+					break;
+				}
+
+				size_t id;
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					completed.wait(guard, [this] { return !finished.empty(); });
+					id = finished.front();
+					finished.pop_front();
+				}
+				--running;
+
+				Job& job = *jobs[id];
+				job.state = job.result.started && job.result.code == 0 ? SUCCEEDED : FAILED;
+				if (job.state == FAILED) {
+					++failures;
+					stopping = stopping || !keepGoing;
+				}
+				if (!done(id)) {
+					stopping = true;
+				}
+			}
+
+			//anything still waiting depends on itself through a cycle
+			for (size_t id = 0; id < jobs.size(); ++id) {
+				if (jobs[id]->state == WAITING) {
+					jobs[id]->state = SKIPPED;
+					++failures;
+					done(id);
+				}
+			}
+
+			for (auto& thread : threads) {
+				thread.join();
+			}
+
+			return failures;
+		} //run
+}; //JobRunner
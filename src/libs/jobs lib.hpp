@@ -0,0 +1,177 @@
+#pragma once
+
+#include <string>
+
+#include "luacpp.hpp"
+#include "luafile lib.hpp"
+#include "job runner.hpp"
+
+/*
+*	Lua access to JobRunner (library "jobs", userdata "JobRunner")
+*
+*		jobs.new([limit [, keep_going]])	limit, at least 1, defaults to the number of hardware threads
+*
+*		runner:add{ cmd = "pjass common.j war3map.j", deps = { id, ... }, done = function(job) end }
+*											returns the id of the job
+*		runner:run()						runs the jobs and returns once every one has ended,
+*											true if every job succeeded, and the failure count
+*
+*	done is called on the script's thread as each job finishes with
+*
+*		job.id, job.cmd, job.code, job.ok, job.skipped
+*		job.stdout, job.stderr				LuaFile buffers holding the captured output
+*
+*	Commands run concurrently while run() waits; the script continues only in done callbacks,
+*	as each job completes. done may add further jobs, the running run() picks them up.
+*/
+class JobsLib {
+	private:
+		struct Runner {
+			JobRunner runner;
+			size_t limit;
+			bool keepGoing;
+		};
+
+		static Runner* check(Lua& lua, int index) {
+			return *(Runner**)lua.l_checkudata(index, "JobRunner");
+		} //check
+
+		static int l_gc(Lua::State* L) {
+			Lua lua(L);
+			Runner** runner = (Runner**)lua.l_checkudata(1, "JobRunner");
+			delete *runner;
+			*runner = nullptr;
+			return 0;
+		} //l_gc
+
+		static int l_new(Lua::State* L) {
+			Lua lua(L);
+
+			unsigned threads = std::thread::hardware_concurrency();
+			Lua::Integer limit = lua.l_optinteger(1, threads > 0 ? (Lua::Integer)threads : 1);
+			if (limit < 1) {
+				return lua.l_argerror(1, "limit must be at least 1");
+			}
+
+			Runner* runner = new Runner();
+			runner->limit = (size_t)limit;
+			runner->keepGoing = lua.toboolean(2) != 0;
+
+			*(Runner**)lua.newuserdata(sizeof(Runner*)) = runner;
+			lua.l_getmetatable("JobRunner");
+			lua.setmetatable(-2);
+
+			//callbacks by job id
+			lua.newtable();
+			lua.setfenv(-2);
+			return 1;
+		} //l_new
+
+		static int l_add(Lua::State* L) {
+			Lua lua(L);
+			Runner* runner = check(lua, 1);
+			lua.l_checktype(2, LUA_TTABLE);
+
+			lua.getfield(2, "cmd");
+			std::string command = lua.l_checkstring(-1);
+			lua.pop(1);
+
+			std::vector<size_t> deps;
+			lua.getfield(2, "deps");
+			if (lua.istable(-1)) {
+				for (int i = 1, count = (int)lua.objlen(-1); i <= count; ++i) {
+					lua.rawgeti(-1, i);
+					deps.push_back((size_t)lua.tointeger(-1) - 1);
+					lua.pop(1);
+				}
+			}
+			lua.pop(1);
+
+			size_t id = runner->runner.add(command, deps);
+
+			lua.getfenv(1);
+			lua.getfield(2, "done");
+			lua.rawseti(-2, (int)id + 1);
+			lua.pop(1);
+
+			lua.pushinteger((Lua::Integer)id + 1);
+			return 1;
+		} //l_add
+
+		static int l_run(Lua::State* L) {
+			Lua lua(L);
+			Runner* runner = check(lua, 1);
+			lua.settop(1);
+			lua.getfenv(1);
+
+			//an error raised by a callback is rethrown once the running jobs are joined
+			bool failed = false;
+
+			size_t failures = runner->runner.run(runner->limit, runner->keepGoing, [&](size_t id) {
+				lua.rawgeti(2, (int)id + 1);
+				if (!lua.isfunction(-1) || failed) {
+					lua.pop(1);
+					return !failed;
+				}
+
+				JobRunner::Job& job = runner->runner.job(id);
+				lua.createtable(0, 7);
+				lua.pushinteger((Lua::Integer)id + 1);
+				lua.setfield(-2, "id");
+				lua.pushstring(job.command.c_str());
+				lua.setfield(-2, "cmd");
+				lua.pushinteger(job.result.code);
+				lua.setfield(-2, "code");
+				lua.pushboolean(job.state == JobRunner::SUCCEEDED);
+				lua.setfield(-2, "ok");
+				lua.pushboolean(job.state == JobRunner::SKIPPED);
+				lua.setfield(-2, "skipped");
+				LuaFileLib::push(lua)->write(job.result.out.data(), job.result.out.size());
+				lua.setfield(-2, "stdout");
+				LuaFileLib::push(lua)->write(job.result.err.data(), job.result.err.size());
+				lua.setfield(-2, "stderr");
+
+				//the output now lives in the LuaFiles
+				std::string().swap(job.result.out);
+				std::string().swap(job.result.err);
+
+				if (lua.pcall(1, 0, 0) != 0) {
+					failed = true;
+					return false;
+				}
+				return true;
+			});
+
+			if (failed) {
+				return lua.error();
+			}
+
+			lua.pushboolean(failures == 0);
+			lua.pushinteger((Lua::Integer)failures);
+			return 2;
+		} //l_run
+
+	public:
+		static void attach(Lua& lua) {
+			static const Lua::l_Reg methods[] = {
+				{ "add", l_add },
+				{ "run", l_run },
+				{ nullptr, nullptr }
+			};
+			static const Lua::l_Reg lib[] = {
+				{ "new", l_new },
+				{ nullptr, nullptr }
+			};
+
+			lua.l_newmetatable("JobRunner");
+			lua.pushcfunction(l_gc);
+			lua.setfield(-2, "__gc");
+			lua.newtable();
+			lua.l_register(nullptr, methods);
+			lua.setfield(-2, "__index");
+			lua.pop(1);
+
+			lua.l_register("jobs", lib);
+			lua.pop(1);
+		} //attach
+}; //JobsLib
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+/*
+*	Minimal JSON writing helpers for the reports written by the runner
+*/
+namespace Json {
+	//writes s as a quoted JSON string
+	inline void string(std::ostream& out, const std::string& s) {
+		static const char* hex = "0123456789abcdef";
+
+		out << '"';
+		for (auto c : s) {
+			switch (c) {
+				case '"': out << "\\\""; break;
+				case '\\': out << "\\\\"; break;
+				case '\n': out << "\\n"; break;
+				case '\r': out << "\\r"; break;
+				case '\t': out << "\\t"; break;
+				default:
+					if ((unsigned char)c < 0x20) {
+						out << "\\u00" << hex[(c >> 4) & 0xf] << hex[c & 0xf];
+					} else {
+						out << c;
+					}
+			}
+		}
+		out << '"';
+	} //string
+} //Json
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+#include "luacpp.hpp"
+#include "trace.hpp"
+
+struct EmbeddedModule {
+	const char* name;
+	const unsigned char* code;
+	size_t size;
+};
+
+#include "embedded modules.hpp"
+
+/*
+*	LuaPool
+*
+*	Keeps a set of initialized Lua states with the standard libraries opened and the
+*	embedded build modules already required. States are checked out for a task and
+*	reset to their initial globals when checked back in.
+*
+*	A reset restores the globals, package.loaded, the tables they hold two levels down
+*	(library and module tables, package.path, package.loaders) and their metatables.
+*	Changes deeper than that (a.b.c.d = x) and metatables replaced with setmetatable
+*	survive a checkin, tasks sharing a pool should not make them.
+*/
+class LuaPool {
+	private:
+		std::mutex lock;
+		std::condition_variable released;
+
+		std::vector<Lua*> states;
+		std::vector<Lua*> idle;
+		size_t capacity;
+
+		//run on each new state before the embedded modules are required and before its snapshot, so
+		//package.loaders wrappers (the JIT policy) see the modules and whatever it registers survives resets
+		std::function<void(Lua&)> setup;
+
+		//registry key of the snapshots, a table mapping each tracked table to a copy of its initial contents
+		static const char* snapshotsKey() { return "LuaPool.snapshots"; }
+
+		//copies the table at index into snapshots, then the tables it holds and its metatable down to depth more levels
+		static void snapshot(Lua& lua, int snapshots, int index, int depth) {
+			lua.pushvalue(index);
+			lua.rawget(snapshots);
+			bool known = !lua.isnil(-1);
+			lua.pop(1);
+			if (known) {
+				return;
+			}
+
+			lua.pushvalue(index);
+			lua.newtable();
+			int copy = lua.gettop();
+			lua.pushnil();
+			while (lua.next(index)) {
+				lua.pushvalue(-2);
+				lua.insert(-2);
+				lua.rawset(copy);
+			}
+			lua.rawset(snapshots);
+
+			if (depth > 0) {
+				lua.pushnil();
+				while (lua.next(index)) {
+					if (lua.istable(-1)) {
+						snapshot(lua, snapshots, lua.gettop(), depth - 1);
+					}
+					lua.pop(1);
+				}
+				if (lua.getmetatable(index)) {
+					snapshot(lua, snapshots, lua.gettop(), depth - 1);
+					lua.pop(1);
+				}
+			}
+		} //snapshot
+
+		//removes keys added to the table at index since the snapshot at saved and restores the snapshot values
+		static void restore(Lua& lua, int index, int saved) {
+			int top = lua.gettop();
+
+			//collect added keys first, the table cannot be modified while traversing it
+			lua.newtable();
+			int added = lua.gettop();
+			int count = 0;
+			lua.pushnil();
+			while (lua.next(index)) {
+				lua.pop(1);
+				lua.pushvalue(-1);
+				lua.rawget(saved);
+				if (lua.isnil(-1)) {
+					lua.pushvalue(-2);
+					lua.rawseti(added, ++count);
+				}
+				lua.pop(1);
+			}
+			for (int i = 1; i <= count; ++i) {
+				lua.rawgeti(added, i);
+				lua.pushnil();
+				lua.rawset(index);
+			}
+
+			lua.pushnil();
+			while (lua.next(saved)) {
+				lua.pushvalue(-2);
+				lua.insert(-2);
+				lua.rawset(index);
+			}
+
+			lua.settop(top);
+		} //restore
+
+		Lua* create() {
+			Trace::Scope scope("lua", "create state");
+			Lua* lua = new Lua();
+			lua->l_openlibs();
+
+			//register the embedded modules as preloads so that they can require each other
+			lua->getglobal("package");
+			lua->getfield(-1, "preload");
+			for (const EmbeddedModule* module = embedded_modules; module->name != nullptr; ++module) {
+				if (lua->l_loadbuffer((const char*)module->code, module->size, module->name) == 0) {
+					lua->setfield(-2, module->name);
+				} else {
+					lua->pop(1);
+				}
+			}
+			lua->pop(2);
+
+			if (setup) {
+				setup(*lua);
+				lua->settop(0);
+			}
+
+			for (const EmbeddedModule* module = embedded_modules; module->name != nullptr; ++module) {
+				lua->getglobal("require");
+				lua->pushstring(module->name);
+				if (lua->pcall(1, 0, 0) != 0) {
+					lua->pop(1);
+				}
+			}
+
+			//globals, library tables and what they hold (package.path, package.loaders, string.format...)
+			lua->newtable();
+			int snapshots = lua->gettop();
+			snapshot(*lua, snapshots, LUA_GLOBALSINDEX, 2);
+			lua->getglobal("package");
+			lua->getfield(-1, "loaded");
+			snapshot(*lua, snapshots, lua->gettop(), 2);
+			lua->pop(2);
+			//the metatable shared by all strings
+			lua->pushstring("");
+			if (lua->getmetatable(-1)) {
+				snapshot(*lua, snapshots, lua->gettop(), 1);
+				lua->pop(1);
+			}
+			lua->pop(1);
+			lua->setfield(LUA_REGISTRYINDEX, snapshotsKey());
+
+			return lua;
+		} //create
+
+		//returns every tracked table to its snapshot
+		static void reset(Lua& lua) {
+			Trace::Scope scope("lua", "reset state");
+			lua.settop(0);
+
+			lua.getfield(LUA_REGISTRYINDEX, snapshotsKey());
+			int snapshots = lua.gettop();
+			lua.pushnil();
+			while (lua.next(snapshots)) {
+				restore(lua, lua.gettop() - 1, lua.gettop());
+				lua.pop(1);
+			}
+			lua.settop(0);
+
+			lua.gc(LUA_GCCOLLECT, 0);
+		} //reset
+
+		//hide copy
+		LuaPool(const LuaPool&);
+		LuaPool& operator=(const LuaPool&);
+
+	public:
+		//warm is the number of states created up front, capacity the most that will ever exist
+		//setup may run on several threads at once when states are created on checkout
+		LuaPool(size_t warm, size_t capacity, std::function<void(Lua&)> setup = nullptr) : capacity(capacity < 1 ? 1 : capacity), setup(setup) {
+			if (warm > this->capacity) {
+				warm = this->capacity;
+			}
+
+			for (size_t i = 0; i < warm; ++i) {
+				states.push_back(create());
+				idle.push_back(states.back());
+			}
+		}
+
+		~LuaPool() {
+			for (auto state : states) {
+				delete state;
+			}
+		}
+
+		//returns an idle state, creating one if under capacity, otherwise waits for a checkin
+		Lua* checkout() {
+			std::unique_lock<std::mutex> guard(lock);
+
+			if (idle.empty() && states.size() < capacity) {
+				states.push_back(nullptr);
+				guard.unlock();
+				Lua* lua = create();
+				guard.lock();
+				for (auto& state : states) {
+					if (state == nullptr) {
+						state = lua;
+						break;
+					}
+				}
+				return lua;
+			}
+
+			if (idle.empty()) {
+				Trace::Scope scope("wait", "lua state");
+				released.wait(guard, [this] { return !idle.empty(); });
+			}
+
+			Lua* lua = idle.back();
+			idle.pop_back();
+			return lua;
+		} //checkout
+
+		//resets a state and makes it available again
+		void checkin(Lua* lua) {
+			reset(*lua);
+
+			std::lock_guard<std::mutex> guard(lock);
+			idle.push_back(lua);
+			released.notify_one();
+		} //checkin
+}; //LuaPool
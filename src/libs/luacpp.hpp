@@ -14,6 +14,8 @@
 #pragma once
 
 #include <fstream>
+#include <string>
+#include <cstdarg>
 
 #include "lua.hpp"
 
@@ -140,19 +142,24 @@ public:
 		State* L;
 		bool dependent;
 
-		static class Compiler {
+		class Compiler {
 			private:
-				static std::fstream file;
-
 				//writer for compiler
 				static int writer(State* L, const void* p, size_t size, void* u) {
-					file.write((const char*)p, size);
+					((std::fstream*)u)->write((const char*)p, size);
 					return 0;
 				} //writer
 
+				//writer for in memory compiler
+				static int bufferwriter(State* L, const void* p, size_t size, void* u) {
+					((std::string*)u)->append((const char*)p, size);
+					return 0;
+				} //bufferwriter
+
 			public:
 				//execute compiler
 				static bool execute(State* L, char* input, const char* output) {
+					std::fstream file;
 					file.open(input, std::ios::in | std::ios::binary);
 					if (!file.is_open()) {
 						return false;
@@ -164,17 +171,27 @@ public:
 					if (!file.is_open()) {
 						return false;
 					}
-					lua_dump(L, writer, NULL);
+					lua_dump(L, writer, &file);
 					file.close();
 
 					return true;
 				} //compile
+
+				//execute compiler, outputs to buffer
+				static bool execute(State* L, const char* input, std::string& output) {
+					if (luaL_loadfile(L, input) != 0) {
+						lua_pop(L, 1);
+						return false;
+					}
+					lua_dump(L, bufferwriter, &output);
+					lua_pop(L, 1);
+
+					return true;
+				} //compile
 		}; //Compiler
 
 		//hide = operator
 		Lua* operator=(Lua& rhs) { return nullptr; }
-
-		Lua(State* L) { this->L = L; dependent = true; }
 	public:
 
 		/*
@@ -191,6 +208,8 @@ public:
 		//
 		//There is no explicit function to close or to destroy a thread. Threads are subject to garbage collection, like any Lua object.
 		Lua(Lua& lua) { L = lua_newthread(lua.L); dependent = true;}
+		//Wraps an existing state without taking ownership of it. Used by C functions to work with the state they were called from.
+		Lua(State* L) { this->L = L; dependent = true; }
 		
 		//Destroys all objects in the given Lua state (calling the corresponding garbage-collection metamethods, if any) and frees all dynamic memory used by this state. On several platforms, you may not need to call this function, because all resources are naturally released when the host program ends. On the other hand, long-running programs that create multiple states, such as daemons or web servers, might need to close states as soon as they are not needed.
 		~Lua() { if (!dependent) lua_close(L); }
@@ -201,6 +220,10 @@ public:
 
 		//compiles an input file to bytecode, outputs to output file
 		inline bool compile(char* input, const char* output) { return Compiler::execute(L, input, output); }
+		//compiles an input file to bytecode, outputs to buffer
+		inline bool compile(const char* input, std::string& output) { return Compiler::execute(L, input, output); }
+		//returns the underlying state
+		inline State* state() { return L; }
 		//returns true if Lua object is a child thread of another Lua object
 		inline bool isdependent() { return dependent; }
 
@@ -399,7 +422,7 @@ public:
 		//
 		//	You do not have to allocate space for the result: the result is a Lua string and Lua takes care of memory allocation (and deallocation, through garbage collection).
 		//	The conversion specifiers are quite restricted. There are no flags, widths, or precisions. The conversion specifiers can only be '%%' (inserts a '%' in the string), '%s' (inserts a zero-terminated string, with no size restrictions), '%f' (inserts a lua_Number), '%p' (inserts a pointer as a hexadecimal numeral), '%d' (inserts an int), and '%c' (inserts an int as a byte).
-		inline const char* pushfstring(const char* fmt, ...) { va_list argptr; va_start(argptr,fmt); return lua_pushfstring(L, fmt, argptr); }
+		inline const char* pushfstring(const char* fmt, ...) { va_list argptr; va_start(argptr,fmt); const char* s = lua_pushvfstring(L, fmt, argptr); va_end(argptr); return s; }
 		//Pushes a number with value n onto the stack.
 		inline void pushinteger(Integer n) { lua_pushinteger(L, n); }
 		//Pushes a light userdata onto the stack.
@@ -665,7 +688,7 @@ public:
 		//Raises an error. The error message format is given by fmt plus any extra arguments, following the same rules of lua_pushfstring. It also adds at the beginning of the message the file name and the line number where the error occurred, if this information is available.
 		//
 		//This function never returns, but it is an idiom to use it in C functions as return luaL_error(args).
-		inline int l_error(const char* fmt, ...) { va_list argptr; va_start(argptr,fmt); return luaL_error(L, fmt, argptr); }
+		inline int l_error(const char* fmt, ...) { va_list argptr; va_start(argptr,fmt); luaL_where(L, 1); lua_pushvfstring(L, fmt, argptr); va_end(argptr); lua_concat(L, 2); return lua_error(L); }
 		//This function produces the return values for process-related functions in the standard library (os.execute and io.close).
 		inline int l_execresult(int stat) { return luaL_execresult(L, stat); }
 		//This function produces the return values for file-related functions in the standard library (io.open, os.rename, file:seek, etc.).
@@ -774,4 +797,4 @@ public:
 		//	LUAJIT_MODE_ON
 		//	LUAJIT_MODE_FLUSH
 		int setmode(int index, int mode) { return luaJIT_setmode(L, index, mode); }
-};
+};
\ No newline at end of file
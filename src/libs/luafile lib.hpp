@@ -0,0 +1,226 @@
+#pragma once
+
+#include <new>
+#include <vector>
+#include <fstream>
+
+#include "luacpp.hpp"
+#include "luafile.hpp"
+#include "io helper.hpp"
+
+/*
+*	Lua access to LuaFile (library "luafile", userdata "LuaFile")
+*
+*		luafile.new()			empty file
+*		luafile.read(path)		file holding the contents of path
+*
+*		file:write(s, ...)		appends strings
+*		file:append(other)		appends the spans of another file, keeping its buffers alive
+*		file:size()				size in bytes
+*		file:dump(path)			writes the file out
+*		file:tostring()			contents as a string
+*
+*	A LuaFile is a list of spans over buffers it owns. Native code that produces a buffer
+*	(file reads, archive extraction, process output) hands it over with adopt, so the
+*	text is never copied into a Lua string unless a script asks for it.
+*/
+class LuaFileLib {
+	public:
+		class Object {
+			private:
+				std::vector<IO_Helper::Data*> buffers;
+
+			public:
+				LuaFile file;
+
+				~Object() {
+					for (auto buffer : buffers) {
+						delete buffer;
+					}
+				}
+
+				//takes ownership of data and appends its first size bytes
+				void adopt(IO_Helper::Data* data, size_t size) {
+					buffers.push_back(data);
+					if (size > 0) {
+						file.write(data->str, data->str + size - 1);
+					}
+				} //adopt
+
+				//copies and appends a string
+				void write(const char* s, size_t size) {
+					if (size == 0) {
+						return;
+					}
+					IO_Helper::Data* data = new IO_Helper::Data();
+					data->str = new char[size + 1];
+					data->size = size;
+					std::copy(s, s + size, data->str);
+					data->str[size] = 0;
+					adopt(data, size);
+				} //write
+
+				//appends the spans of other, the buffers stay owned by other
+				//the spans are taken first, other may be this file
+				void append(Object& other) {
+					std::vector<std::pair<char*, size_t>> spans;
+					other.file.each([&spans](char* start, size_t size) {
+						spans.push_back(std::make_pair(start, size));
+					});
+					for (auto& span : spans) {
+						file.write(span.first, span.first + span.second - 1);
+					}
+				} //append
+
+				//copies the contents into a single buffer
+				std::string str() {
+					std::string out;
+					out.reserve(file.size());
+					file.each([&out](const char* start, size_t size) {
+						out.append(start, size);
+					});
+					return out;
+				} //str
+		}; //Object
+
+		static Object* check(Lua& lua, int index) {
+			return (Object*)lua.l_checkudata(index, "LuaFile");
+		} //check
+
+		//pushes a new empty LuaFile
+		static Object* push(Lua& lua) {
+			Object* object = new (lua.newuserdata(sizeof(Object))) Object();
+			lua.l_getmetatable("LuaFile");
+			lua.setmetatable(-2);
+			return object;
+		} //push
+
+	private:
+		static int l_gc(Lua::State* L) {
+			Lua lua(L);
+			check(lua, 1)->~Object();
+			return 0;
+		} //l_gc
+
+		static int l_new(Lua::State* L) {
+			Lua lua(L);
+			push(lua);
+			return 1;
+		} //l_new
+
+		static int l_read(Lua::State* L) {
+			Lua lua(L);
+			const char* filename = lua.l_checkstring(1);
+
+			IO_Helper::Data* data = IO_Helper::read(filename);
+			if (data->str == nullptr) {
+				delete data;
+				lua.pushnil();
+				lua.pushfstring("cannot read %s", filename);
+				return 2;
+			}
+
+			//IO_Helper::read counts the terminator in size
+			push(lua)->adopt(data, data->size - 1);
+			return 1;
+		} //l_read
+
+		static int l_write(Lua::State* L) {
+			Lua lua(L);
+			Object* object = check(lua, 1);
+
+			for (int i = 2, top = lua.gettop(); i <= top; ++i) {
+				size_t size;
+				const char* s = lua.l_checklstring(i, &size);
+				object->write(s, size);
+			}
+
+			lua.settop(1);
+			return 1;
+		} //l_write
+
+		static int l_append(Lua::State* L) {
+			Lua lua(L);
+			Object* object = check(lua, 1);
+			Object* other = check(lua, 2);
+
+			object->append(*other);
+			if (other == object) {
+				lua.settop(1);
+				return 1;
+			}
+
+			//keep other alive as long as object references its buffers
+			//a new userdata shares the globals as environment until it gets its own
+			lua.getfenv(1);
+			if (!lua.istable(-1) || lua.rawequal(-1, LUA_GLOBALSINDEX)) {
+				lua.pop(1);
+				lua.newtable();
+				lua.pushvalue(-1);
+				lua.setfenv(1);
+			}
+			lua.pushvalue(2);
+			lua.rawseti(-2, (int)lua.objlen(-2) + 1);
+
+			lua.settop(1);
+			return 1;
+		} //l_append
+
+		static int l_size(Lua::State* L) {
+			Lua lua(L);
+			lua.pushnumber((Lua::Number)check(lua, 1)->file.size());
+			return 1;
+		} //l_size
+
+		static int l_dump(Lua::State* L) {
+			Lua lua(L);
+			Object* object = check(lua, 1);
+			const char* filename = lua.l_checkstring(2);
+
+			std::ofstream out(filename, std::ios::binary);
+			if (!out.is_open()) {
+				lua.pushnil();
+				lua.pushfstring("cannot open %s", filename);
+				return 2;
+			}
+			object->file.dump(out);
+
+			lua.pushboolean(!out.fail());
+			return 1;
+		} //l_dump
+
+		static int l_tostring(Lua::State* L) {
+			Lua lua(L);
+			std::string s = check(lua, 1)->str();
+			lua.pushlstring(s.data(), s.size());
+			return 1;
+		} //l_tostring
+
+	public:
+		static void attach(Lua& lua) {
+			static const Lua::l_Reg methods[] = {
+				{ "write", l_write },
+				{ "append", l_append },
+				{ "size", l_size },
+				{ "dump", l_dump },
+				{ "tostring", l_tostring },
+				{ nullptr, nullptr }
+			};
+			static const Lua::l_Reg lib[] = {
+				{ "new", l_new },
+				{ "read", l_read },
+				{ nullptr, nullptr }
+			};
+
+			lua.l_newmetatable("LuaFile");
+			lua.pushcfunction(l_gc);
+			lua.setfield(-2, "__gc");
+			lua.newtable();
+			lua.l_register(nullptr, methods);
+			lua.setfield(-2, "__index");
+			lua.pop(1);
+
+			lua.l_register("luafile", lib);
+			lua.pop(1);
+		} //attach
+}; //LuaFileLib
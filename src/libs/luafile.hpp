@@ -5,6 +5,8 @@
 #include <fstream>
 #include <limits>
 
+#include "trace.hpp"
+
 class LuaFile {
 	private:
 		struct Data {
@@ -76,8 +78,8 @@ class LuaFile {
 				}
 
 				~Queue() {
-					Node* node = first;
-					while (node != nullptr) {
+					while (first != nullptr) {
+						Node* node = first;
 						first = node->next;
 						delete node;
 					}
@@ -209,6 +211,8 @@ class LuaFile {
 		}
 
 		void dump(std::ostream& out) const {
+			Trace::Scope scope("luafile", "dump");
+
 			for (auto node = file.first; node != 0; node = node->next) {
 				for (uint32_t i = 0; i < node->data.pos; ++i) {
 					out.write(node->data[i].start, static_cast<std::streamsize>(node->data[i].end - node->data[i].start + 1));
@@ -216,5 +220,23 @@ class LuaFile {
 			}
 		}
 
+		//calls fn(start, size) for each span in order
+		template <class Fn>
+		void each(Fn fn) const {
+			for (auto node = file.first; node != 0; node = node->next) {
+				for (uint32_t i = 0; i < node->data.pos; ++i) {
+					fn(node->data[i].start, static_cast<size_t>(node->data[i].end - node->data[i].start + 1));
+				}
+			}
+		}
+
+		//appends the span [start, end] to the last region
+		void write(char* start, char* end) {
+			if (file.last == nullptr) {
+				file.push();
+			}
+			file.last->data.push_back(Data{start, end});
+		}
+
 		iterator begin() { return iterator(&file); }
 };
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/*
+*	MappedFile
+*
+*	Read only memory mapping of a whole file. An empty file opens with a null data
+*	pointer and a size of 0.
+*/
+class MappedFile {
+	private:
+		const char* mapped;
+		size_t length;
+
+#ifdef _WIN32
+		HANDLE file;
+		HANDLE mapping;
+#endif
+
+		//hide copy
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+
+	public:
+#ifdef _WIN32
+		MappedFile() : mapped(nullptr), length(0), file(INVALID_HANDLE_VALUE), mapping(nullptr) { }
+#else
+		MappedFile() : mapped(nullptr), length(0) { }
+#endif
+
+		~MappedFile() { close(); }
+
+		bool open(const char* filename) {
+			close();
+
+#ifdef _WIN32
+			file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE) {
+				return false;
+			}
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(file, &size)) {
+				close();
+				return false;
+			}
+			length = (size_t)size.QuadPart;
+			if (length == 0) {
+				return true;
+			}
+
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping == nullptr) {
+				close();
+				return false;
+			}
+			mapped = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+			int fd = ::open(filename, O_RDONLY);
+			if (fd == -1) {
+				return false;
+			}
+
+			struct stat info;
+			if (fstat(fd, &info) != 0) {
+				::close(fd);
+				return false;
+			}
+			length = (size_t)info.st_size;
+			if (length == 0) {
+				::close(fd);
+				return true;
+			}
+
+			void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+			mapped = view == MAP_FAILED ? nullptr : (const char*)view;
+#endif
+
+			if (mapped == nullptr) {
+				close();
+				return false;
+			}
+			return true;
+		} //open
+
+		void close() {
+#ifdef _WIN32
+			if (mapped != nullptr) {
+				UnmapViewOfFile(mapped);
+			}
+			if (mapping != nullptr) {
+				CloseHandle(mapping);
+			}
+			if (file != INVALID_HANDLE_VALUE) {
+				CloseHandle(file);
+			}
+			mapping = nullptr;
+			file = INVALID_HANDLE_VALUE;
+#else
+			if (mapped != nullptr) {
+				munmap((void*)mapped, length);
+			}
+#endif
+			mapped = nullptr;
+			length = 0;
+		} //close
+
+		const char* data() const { return mapped; }
+		size_t size() const { return length; }
+}; //MappedFile
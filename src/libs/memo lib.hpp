@@ -0,0 +1,330 @@
+#pragma once
+
+#include <algorithm>
+
+#include "luacpp.hpp"
+#include "memo.hpp"
+
+/*
+*	Lua access to Memo (library "memo")
+*
+*		memo.wrap(name, fn [, options])		fn memoized by its arguments and the files it reads
+*		memo.dir(path)						directory of the disk tier, false for memory only
+*		memo.stats()						memory hits, disk hits, misses
+*
+*	options
+*
+*		files = { 1, 3 }		arguments that are paths (or lists of paths) read by fn
+*		files = function(...)	returns the list of paths read by fn for the arguments
+*		version = "2"			changes every key, for when fn itself changes
+*
+*	for example
+*
+*		preprocess = memo.wrap("preprocess", preprocess, { files = { 1 } })
+*		local code = preprocess("libs/core.j", { DEBUG = true })
+*
+*	Arguments and results may be nil, booleans, numbers, strings and tables of them.
+*	Tables that contain themselves, or nest or repeat so much that they serialize to more
+*	than 64 MB, are refused. Results that cannot be stored are returned without being
+*	memoized.
+*/
+class MemoLib {
+	private:
+		static const int maxDepth = 64;
+		static const size_t maxBytes = 64 << 20;
+
+		//tables being serialized, from the outermost, and the bytes written so far
+		struct Walk {
+			std::vector<const void*> tables;
+			size_t bytes;
+
+			Walk() : bytes(0) { }
+		};
+
+		static void writeSize(std::string& out, size_t size) {
+			uint32_t value = (uint32_t)size;
+			out.append((const char*)&value, 4);
+		} //writeSize
+
+		//appends the value at index, tables with their pairs sorted so equal tables give equal bytes
+		//false for values that cannot be stored, a table within itself and values over maxBytes
+		static bool serialize(Lua& lua, int index, std::string& out, Walk& walk) {
+			if (walk.bytes > maxBytes) {
+				return false;
+			}
+
+			switch (lua.type(index)) {
+				case LUA_TNIL:
+					out += 'n';
+					return true;
+				case LUA_TBOOLEAN:
+					out += lua.toboolean(index) ? 't' : 'f';
+					return true;
+				case LUA_TNUMBER: {
+					Lua::Number number = lua.tonumber(index);
+					out += 'd';
+					out.append((const char*)&number, sizeof(number));
+					walk.bytes += 1 + sizeof(number);
+					return true;
+				}
+				case LUA_TSTRING: {
+					size_t size;
+					const char* s = lua.tolstring(index, &size);
+					out += 's';
+					writeSize(out, size);
+					out.append(s, size);
+					walk.bytes += 5 + size;
+					return true;
+				}
+				case LUA_TTABLE: {
+					const void* table = lua.topointer(index);
+					if ((int)walk.tables.size() >= maxDepth || std::find(walk.tables.begin(), walk.tables.end(), table) != walk.tables.end()) {
+						return false;
+					}
+
+					if (index < 0) {
+						index = lua.gettop() + index + 1;
+					}
+
+					walk.tables.push_back(table);
+					walk.bytes += 5;
+					std::vector<std::pair<std::string, std::string>> pairs;
+					lua.pushnil();
+					while (lua.next(index)) {
+						std::string key, value;
+						if (!serialize(lua, -2, key, walk) || !serialize(lua, -1, value, walk)) {
+							lua.pop(2);
+							walk.tables.pop_back();
+							return false;
+						}
+						pairs.push_back(std::make_pair(key, value));
+						lua.pop(1);
+					}
+					walk.tables.pop_back();
+					std::sort(pairs.begin(), pairs.end());
+
+					out += 'T';
+					writeSize(out, pairs.size());
+					for (auto& pair : pairs) {
+						out += pair.first;
+						out += pair.second;
+					}
+					return true;
+				}
+				default:
+					return false;
+			}
+		} //serialize
+
+		//pushes the value at data[at], returns false on malformed data
+		static bool deserialize(Lua& lua, const std::string& data, size_t& at, int depth = 0) {
+			if (at >= data.size() || depth > maxDepth || !lua.checkstack(2)) {
+				return false;
+			}
+
+			switch (data[at++]) {
+				case 'n':
+					lua.pushnil();
+					return true;
+				case 't':
+				case 'f':
+					lua.pushboolean(data[at - 1] == 't');
+					return true;
+				case 'd': {
+					Lua::Number number;
+					if (at + sizeof(number) > data.size()) {
+						return false;
+					}
+					memcpy(&number, &data[at], sizeof(number));
+					at += sizeof(number);
+					lua.pushnumber(number);
+					return true;
+				}
+				case 's': {
+					uint32_t size;
+					if (at + 4 > data.size()) {
+						return false;
+					}
+					memcpy(&size, &data[at], 4);
+					at += 4;
+					if (at + size > data.size()) {
+						return false;
+					}
+					lua.pushlstring(data.data() + at, size);
+					at += size;
+					return true;
+				}
+				case 'T': {
+					uint32_t count;
+					if (at + 4 > data.size()) {
+						return false;
+					}
+					memcpy(&count, &data[at], 4);
+					at += 4;
+					//every pair takes at least two bytes, a larger count is corrupt
+					if (count > (data.size() - at) / 2) {
+						return false;
+					}
+					lua.createtable(0, (int)count);
+					for (uint32_t i = 0; i < count; ++i) {
+						if (!deserialize(lua, data, at, depth + 1)) {
+							lua.pop(1);
+							return false;
+						}
+						if (!deserialize(lua, data, at, depth + 1)) {
+							lua.pop(2);
+							return false;
+						}
+						lua.rawset(-3);
+					}
+					return true;
+				}
+				default:
+					return false;
+			}
+		} //deserialize
+
+		//adds the path or list of paths at index to files
+		static void addFiles(Lua& lua, int index, std::vector<std::string>& files) {
+			if (lua.type(index) == LUA_TSTRING) {
+				files.push_back(lua.tostring(index));
+			} else if (lua.istable(index)) {
+				for (int i = 1; ; ++i) {
+					lua.rawgeti(index, i);
+					if (lua.isnil(-1)) {
+						lua.pop(1);
+						break;
+					}
+					if (lua.type(-1) == LUA_TSTRING) {
+						files.push_back(lua.tostring(-1));
+					}
+					lua.pop(1);
+				}
+			}
+		} //addFiles
+
+		//upvalues: name, fn, files option
+		static int l_call(Lua::State* L) {
+			Lua lua(L);
+			int count = lua.gettop();
+
+			std::string arguments;
+			Walk walk;
+			for (int i = 1; i <= count; ++i) {
+				if (!serialize(lua, i, arguments, walk)) {
+					return lua.l_error("memo %s: argument %d cannot be serialized", lua.tostring(lua.upvalueindex(1)), i);
+				}
+			}
+
+			std::vector<std::string> files;
+			int option = lua.upvalueindex(3);
+			if (lua.isfunction(option)) {
+				lua.pushvalue(option);
+				for (int i = 1; i <= count; ++i) {
+					lua.pushvalue(i);
+				}
+				lua.call(count, 1);
+				addFiles(lua, -1, files);
+				lua.pop(1);
+			} else if (lua.istable(option)) {
+				for (int i = 1; ; ++i) {
+					lua.rawgeti(option, i);
+					if (lua.isnil(-1)) {
+						lua.pop(1);
+						break;
+					}
+					int argument = (int)lua.tointeger(-1);
+					lua.pop(1);
+					if (argument >= 1 && argument <= count) {
+						addFiles(lua, argument, files);
+					}
+				}
+			}
+
+			std::string key = Memo::key(lua.tostring(lua.upvalueindex(1)), arguments, files);
+
+			std::string value;
+			if (Memo::shared().get(key, value)) {
+				size_t at = 0;
+				int results = 0;
+				while (at < value.size() && deserialize(lua, value, at)) {
+					++results;
+				}
+				if (at == value.size()) {
+					return results;
+				}
+				lua.settop(count);
+			}
+
+			lua.pushvalue(lua.upvalueindex(2));
+			for (int i = 1; i <= count; ++i) {
+				lua.pushvalue(i);
+			}
+			lua.call(count, LUA_MULTRET);
+
+			int results = lua.gettop() - count;
+			value.clear();
+			bool stored = true;
+			Walk written;
+			for (int i = count + 1; i <= lua.gettop() && stored; ++i) {
+				stored = serialize(lua, i, value, written);
+			}
+			if (stored) {
+				Memo::shared().put(key, value);
+			}
+
+			return results;
+		} //l_call
+
+		static int l_wrap(Lua::State* L) {
+			Lua lua(L);
+			std::string name = lua.l_checkstring(1);
+			lua.l_checktype(2, LUA_TFUNCTION);
+
+			if (lua.istable(3)) {
+				lua.getfield(3, "version");
+				if (lua.isstring(-1)) {
+					name += "@";
+					name += lua.tostring(-1);
+				}
+				lua.pop(1);
+				lua.getfield(3, "files");
+			} else {
+				lua.pushnil();
+			}
+
+			lua.pushlstring(name.data(), name.size());
+			lua.pushvalue(2);
+			lua.pushvalue(-3);
+			lua.pushccloser(l_call, 3);
+			return 1;
+		} //l_wrap
+
+		static int l_dir(Lua::State* L) {
+			Lua lua(L);
+			Memo::shared().setDirectory(lua.isstring(1) ? lua.tostring(1) : "");
+			return 0;
+		} //l_dir
+
+		static int l_stats(Lua::State* L) {
+			Lua lua(L);
+			size_t memory, disk, misses;
+			Memo::shared().stats(memory, disk, misses);
+			lua.pushnumber((Lua::Number)memory);
+			lua.pushnumber((Lua::Number)disk);
+			lua.pushnumber((Lua::Number)misses);
+			return 3;
+		} //l_stats
+
+	public:
+		static void attach(Lua& lua) {
+			static const Lua::l_Reg lib[] = {
+				{ "wrap", l_wrap },
+				{ "dir", l_dir },
+				{ "stats", l_stats },
+				{ nullptr, nullptr }
+			};
+			lua.l_register("memo", lib);
+			lua.pop(1);
+		} //attach
+}; //MemoLib
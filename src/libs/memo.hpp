@@ -0,0 +1,192 @@
+#pragma once
+
+#include <mutex>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <stdint.h>
+
+#include "zlib.h"
+
+#include "hash.hpp"
+#include "content store.hpp"
+#include "filesystem.hpp"
+#include "trace.hpp"
+
+/*
+*	Memo
+*
+*	Results of pure build steps by key. The memory tier is the shared ContentStore, the
+*	disk tier one zlib compressed file per key under a directory, so results survive
+*	between runs. An entry on disk is written to a temporary name and moved in place,
+*	concurrent runs never read half written entries.
+*
+*	Steps that are cheap to redo (the module index) pass onRequest and reach the disk
+*	only when a directory was chosen with setDirectory, so that plain runs leave no
+*	.memo directory behind for them.
+*
+*	Entry file: "MEMO", uint32 size of the value, zlib stream of the value
+*/
+class Memo {
+	private:
+		std::mutex lock;
+		std::string directory;
+		bool disk;
+		bool chosen;	//setDirectory was called, the directory is not the default
+
+		size_t hits;
+		size_t diskHits;
+		size_t misses;
+
+		std::string path(const std::string& key) const {
+			return FileSystem::join(directory, key.substr(0, 2) + "/" + key);
+		} //path
+
+		static bool unpack(const std::string& data, std::string& value) {
+			if (data.size() < 8 || data.compare(0, 4, "MEMO") != 0) {
+				return false;
+			}
+
+			//deflate expands at most 1032 times, a larger size is a corrupt entry and is not allocated
+			uint32_t size;
+			memcpy(&size, &data[4], 4);
+			if (size > (data.size() - 8) * 1032) {
+				return false;
+			}
+			value.resize(size);
+			uLongf length = size;
+			if (size > 0 && (uncompress((Bytef*)&value[0], &length, (const Bytef*)&data[8], (uLong)(data.size() - 8)) != Z_OK || length != size)) {
+				return false;
+			}
+
+			return true;
+		} //unpack
+
+		static std::string pack(const std::string& value) {
+			uLongf bound = compressBound((uLong)value.size());
+			std::string data(8 + bound, '\0');
+			memcpy(&data[0], "MEMO", 4);
+			uint32_t size = (uint32_t)value.size();
+			memcpy(&data[4], &size, 4);
+			compress2((Bytef*)&data[8], &bound, (const Bytef*)value.data(), (uLong)value.size(), Z_BEST_SPEED);
+			data.resize(8 + bound);
+			return data;
+		} //pack
+
+	public:
+		Memo() : directory(".memo"), disk(true), chosen(false), hits(0), diskHits(0), misses(0) { }
+
+		static Memo& shared() {
+			static Memo memo;
+			return memo;
+		} //shared
+
+		//directory of the disk tier, an empty string keeps results in memory only
+		void setDirectory(const std::string& value) {
+			std::lock_guard<std::mutex> guard(lock);
+			directory = value;
+			disk = !value.empty();
+			chosen = true;
+		} //setDirectory
+
+		//key of a step from its name, its serialized arguments and the files it reads
+		static std::string key(const std::string& name, const std::string& arguments, const std::vector<std::string>& files) {
+			Hash128 hash(2);
+			uint64_t size = name.size();
+			hash.update(&size, sizeof(size));
+			hash.update(name);
+			size = arguments.size();
+			hash.update(&size, sizeof(size));
+			hash.update(arguments);
+
+			//load stats every file afresh and reads it again when it may have changed, so files
+			//written earlier in the run or created since their first lookup hash by their contents
+			for (auto& file : files) {
+				std::string contentKey = ContentStore::shared().load(file);
+				size = file.size();
+				hash.update(&size, sizeof(size));
+				hash.update(file);
+				hash.update(contentKey.empty() ? std::string(32, '-') : contentKey);
+			}
+
+			return hash.hex();
+		} //key
+
+		bool get(const std::string& key, std::string& value, bool onRequest = false) {
+			ContentStore::Buffer buffer = ContentStore::shared().get(key);
+			if (buffer) {
+				value = *buffer;
+				std::lock_guard<std::mutex> guard(lock);
+				++hits;
+				return true;
+			}
+
+			std::string file;
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if (!disk || (onRequest && !chosen)) {
+					++misses;
+					return false;
+				}
+				file = path(key);
+			}
+
+			Trace::Scope scope("memo", "read", key.c_str());
+			std::ifstream in(file.c_str(), std::ios::binary);
+			std::stringstream data;
+			data << in.rdbuf();
+			if (!in.is_open() || !unpack(data.str(), value)) {
+				std::lock_guard<std::mutex> guard(lock);
+				++misses;
+				return false;
+			}
+
+			ContentStore::shared().put(value, key);
+
+			std::lock_guard<std::mutex> guard(lock);
+			++diskHits;
+			return true;
+		} //get
+
+		void put(const std::string& key, const std::string& value, bool onRequest = false) {
+			ContentStore::shared().put(value, key);
+
+			std::string file;
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if (!disk || (onRequest && !chosen)) {
+					return;
+				}
+				file = path(key);
+			}
+
+			Trace::Scope scope("memo", "write", key.c_str());
+			if (!FileSystem::makeDirectories(file.substr(0, file.find_last_of('/')))) {
+				return;
+			}
+
+			std::stringstream temporary;
+			temporary << file << "." << std::this_thread::get_id() << ".tmp";
+			std::string data = pack(value);
+			{
+				std::ofstream out(temporary.str().c_str(), std::ios::binary);
+				out.write(data.data(), data.size());
+				if (!out) {
+					return;
+				}
+			}
+			if (!FileSystem::replace(temporary.str(), file)) {
+				std::remove(temporary.str().c_str());
+			}
+		} //put
+
+		void stats(size_t& memory, size_t& fromDisk, size_t& miss) {
+			std::lock_guard<std::mutex> guard(lock);
+			memory = hits;
+			fromDisk = diskHits;
+			miss = misses;
+		} //stats
+}; //Memo
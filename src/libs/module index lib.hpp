@@ -0,0 +1,132 @@
+#pragma once
+
+#include "luacpp.hpp"
+#include "module index.hpp"
+#include "content store.hpp"
+#include "memo.hpp"
+
+/*
+*	Indexed module loading for require (library "modules")
+*
+*		modules.find(name)		file of module name for the current package.path, or nil
+*		modules.refresh()		drops the indexes, they are checked against the directories again
+*
+*	attach inserts a loader right after the preload loader of package.loaders. It finds
+*	modules through ModuleIndex and loads them as bytecode kept by Memo, so unchanged
+*	modules are not parsed again (between runs only with a memo directory set). Modules
+*	missing from the index, or whose indexed file is gone, fall through to the standard
+*	loaders.
+*/
+class ModuleIndexLib {
+	private:
+		static int writer(Lua::State*, const void* p, size_t size, void* u) {
+			((std::string*)u)->append((const char*)p, size);
+			return 0;
+		} //writer
+
+		//pushes the chunk of file, or the error message and returns false
+		static bool load(Lua& lua, const std::string& file) {
+			std::string chunkname = "@" + file;
+
+			ContentStore::Buffer source;
+			std::string content = ContentStore::shared().load(file, &source);
+			if (content.empty() || !source) {
+				lua.pushfstring("cannot read %s", file.c_str());
+				return false;
+			}
+
+			std::vector<std::string> inputs;
+			inputs.push_back(content);
+			inputs.push_back(chunkname);
+			inputs.push_back(LUAJIT_VERSION);
+			std::string key = ContentStore::derive(inputs, "bytecode");
+
+			std::string code;
+			if (Memo::shared().get(key, code, true)) {
+				if (lua.l_loadbuffer(code.data(), code.size(), chunkname.c_str()) == 0) {
+					return true;
+				}
+				lua.pop(1);
+			}
+
+			Trace::Scope scope("modules", "compile", file.c_str());
+			if (lua.l_loadbuffer(source->data(), source->size(), chunkname.c_str()) != 0) {
+				return false;
+			}
+
+			code.clear();
+			lua.dump(writer, &code);
+			Memo::shared().put(key, code, true);
+
+			return true;
+		} //load
+
+		static std::string path(Lua& lua) {
+			lua.getglobal("package");
+			lua.getfield(-1, "path");
+			std::string path = lua.isstring(-1) ? lua.tostring(-1) : "";
+			lua.pop(2);
+			return path;
+		} //path
+
+		//package.loaders entry
+		static int l_loader(Lua::State* L) {
+			Lua lua(L);
+			const char* name = lua.l_checkstring(1);
+
+			//the index may predate a removal in the same second as its directory mtimes
+			std::string file = ModuleIndex::shared().find(path(lua), name);
+			if (file.empty() || !FileSystem::query(file).exists) {
+				lua.pushfstring("\n\tno indexed module '%s'", name);
+				return 1;
+			}
+
+			if (!load(lua, file)) {
+				return lua.l_error("error loading module '%s' from file '%s':\n\t%s", name, file.c_str(), lua.tostring(-1));
+			}
+
+			return 1;
+		} //l_loader
+
+		static int l_find(Lua::State* L) {
+			Lua lua(L);
+			std::string file = ModuleIndex::shared().find(path(lua), lua.l_checkstring(1));
+			if (file.empty()) {
+				lua.pushnil();
+			} else {
+				lua.pushlstring(file.data(), file.size());
+			}
+			return 1;
+		} //l_find
+
+		static int l_refresh(Lua::State*) {
+			ModuleIndex::shared().refresh();
+			return 0;
+		} //l_refresh
+
+	public:
+		static void attach(Lua& lua) {
+			//shift every loader after the preload loader up by one
+			lua.getglobal("package");
+			lua.getfield(-1, "loaders");
+			if (lua.istable(-1)) {
+				int loaders = lua.gettop();
+				int count = (int)lua.objlen(loaders);
+				for (int i = count; i >= 2; --i) {
+					lua.rawgeti(loaders, i);
+					lua.rawseti(loaders, i + 1);
+				}
+				lua.pushcfunction(l_loader);
+				lua.rawseti(loaders, count >= 1 ? 2 : 1);
+			}
+			lua.pop(2);
+
+			static const Lua::l_Reg lib[] = {
+				{ "find", l_find },
+				{ "refresh", l_refresh },
+				{ nullptr, nullptr }
+			};
+			lua.l_register("modules", lib);
+			lua.pop(1);
+		} //attach
+}; //ModuleIndexLib
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+#include <unordered_map>
+
+#include "filesystem.hpp"
+#include "memo.hpp"
+#include "trace.hpp"
+
+/*
+*	ModuleIndex
+*
+*	Module name to file lookup for a package.path, built with one walk of the directory
+*	of each path template instead of probing every template on every require. Indexes
+*	are kept in the disk tier of Memo with the mtime of every directory they cover, and
+*	rebuilt when any of those directories changed (a file added, removed or renamed).
+*	Indexes are stored per working directory, since relative templates (./?.lua) resolve
+*	against it.
+*
+*	Indexes reach the disk only when a memo directory is set (Memo onRequest), without
+*	one they last for the run.
+*
+*	Hidden directories (.git, .memo) are not indexed, walks stop depth levels below a
+*	template root, and a template rooted at the filesystem root (/?.lua) is not walked.
+*	Templates rooted at the working directory (./?.lua, ?/init.lua) are only walked as
+*	deep as an undotted name needs, so a require does not walk the whole working tree.
+*	Names the index cannot answer for (deeper than the walks, or with such a template in
+*	the path) are left to the regular package.path search.
+*/
+class ModuleIndex {
+	private:
+		static const int depth = 8;
+
+		struct Index {
+			std::unordered_map<std::string, std::string> files;
+			int dots;	//most dots of a name the walks cover in every template, -1 for none
+		};
+
+		//a package.path template split around its ?, "lib/?/init.lua" is { "lib", "", "/init.lua" }
+		struct Template {
+			std::string root;
+			std::string prefix;
+			std::string suffix;
+		};
+
+		std::mutex lock;
+		std::unordered_map<std::string, std::shared_ptr<const Index>> indexes;
+
+		static std::vector<Template> templates(const std::string& path) {
+			std::vector<Template> found;
+
+			size_t start = 0;
+			while (start <= path.size()) {
+				size_t end = path.find(';', start);
+				if (end == std::string::npos) {
+					end = path.size();
+				}
+
+				std::string entry = path.substr(start, end - start);
+				start = end + 1;
+
+				for (auto& c : entry) {
+					if (c == '\\') {
+						c = '/';
+					}
+				}
+
+				size_t mark = entry.find('?');
+				if (mark == std::string::npos) {
+					continue;
+				}
+
+				Template item;
+				size_t separator = entry.find_last_of('/', mark);
+				if (separator == std::string::npos) {
+					item.root = ".";
+					item.prefix = entry.substr(0, mark);
+				} else {
+					item.root = separator == 0 ? "/" : entry.substr(0, separator);
+					item.prefix = entry.substr(separator + 1, mark - separator - 1);
+				}
+				item.suffix = entry.substr(mark + 1);
+				if (item.root.empty() || item.root == "./") {
+					item.root = ".";
+				}
+
+				found.push_back(item);
+			}
+
+			return found;
+		} //templates
+
+		static int64_t mtime(const std::string& dir) {
+			FileSystem::Stat stat = FileSystem::StatCache::shared().get(dir);
+			return stat.exists && stat.directory ? stat.mtime : -1;
+		} //mtime
+
+		//separators between the template root and the file, 0 for "?.lua", 1 for "?/init.lua"
+		static int slashes(const Template& item) {
+			return (int)std::count(item.prefix.begin(), item.prefix.end(), '/') + (int)std::count(item.suffix.begin(), item.suffix.end(), '/');
+		} //slashes
+
+		//levels below its root a template is walked to
+		static int levels(const Template& item) {
+			return item.root == "." ? 1 + slashes(item) : depth;
+		} //levels
+
+		//walks the template roots, fills index and returns the index in its stored form
+		static std::string scan(const std::string& path, Index& index) {
+			Trace::Scope scope("modules", "scan", path.c_str());
+			std::ostringstream stored;
+
+			for (auto& item : templates(path)) {
+				stored << "D\t" << mtime(item.root) << "\t" << item.root << "\n";
+
+				size_t skip = FileSystem::join(item.root, "").size();
+				int limit = levels(item);
+
+				auto hidden = [](const std::string& dir) {
+					size_t slash = dir.find_last_of('/');
+					return dir[slash == std::string::npos ? 0 : slash + 1] == '.';
+				};
+
+				//levels below the root, 1 for its entries
+				auto level = [skip](const std::string& entry) {
+					return (int)std::count(entry.begin() + skip, entry.end(), '/') + 1;
+				};
+
+				//the directories walked are the ones whose changes invalidate the index
+				std::mutex walked;
+				std::vector<std::string> dirs;
+				std::vector<std::string> files = FileSystem::walk(item.root, false, [&](const std::string& entry) {
+					return !hidden(entry);
+				}, [&](const std::string& entry) {
+					if (hidden(entry) || level(entry) >= limit) {
+						return false;
+					}
+					std::lock_guard<std::mutex> guard(walked);
+					dirs.push_back(entry);
+					return true;
+				});
+
+				for (auto& dir : dirs) {
+					stored << "D\t" << mtime(dir) << "\t" << dir << "\n";
+				}
+
+				for (auto& entry : files) {
+					std::string relative = entry.substr(skip);
+					if (relative.size() <= item.prefix.size() + item.suffix.size() ||
+						relative.compare(0, item.prefix.size(), item.prefix) != 0 ||
+						relative.compare(relative.size() - item.suffix.size(), item.suffix.size(), item.suffix) != 0)
+					{
+						continue;
+					}
+
+					//the ? stands for the module name with dots turned into separators
+					std::string name = relative.substr(item.prefix.size(), relative.size() - item.prefix.size() - item.suffix.size());
+					if (name.find('.') != std::string::npos) {
+						continue;
+					}
+					for (auto& c : name) {
+						if (c == '/') {
+							c = '.';
+						}
+					}
+
+					//earlier templates take precedence, as with package.path
+					if (index.files.find(name) == index.files.end()) {
+						index.files[name] = entry;
+						stored << "M\t" << name << "\t" << entry << "\n";
+					}
+				}
+			}
+
+			return stored.str();
+		} //scan
+
+		//most dots of a module name that every template of path is walked deep enough for
+		static int dots(const std::string& path) {
+			int dots = depth;
+			for (auto& item : templates(path)) {
+				if (root(item.root)) {
+					return -1;
+				}
+				int covered = levels(item) - 1 - slashes(item);
+				if (covered < dots) {
+					dots = covered;
+				}
+			}
+			return dots;
+		} //dots
+
+		//true for / and drive roots (C:), which are not walked
+		static bool root(const std::string& dir) {
+			return dir == "/" || (!dir.empty() && dir.back() == ':');
+		} //root
+
+		//reads a stored index, returns false if it is malformed or a directory changed since
+		static bool parse(const std::string& stored, Index& index) {
+			std::istringstream in(stored);
+			std::string line;
+			while (std::getline(in, line)) {
+				size_t first = line.find('\t');
+				size_t second = first == std::string::npos ? std::string::npos : line.find('\t', first + 1);
+				if (second == std::string::npos) {
+					return false;
+				}
+
+				std::string field = line.substr(first + 1, second - first - 1);
+				std::string value = line.substr(second + 1);
+				if (line[0] == 'D') {
+					char* end = nullptr;
+					long long stored = strtoll(field.c_str(), &end, 10);
+					if (field.empty() || *end != 0 || mtime(value) != stored) {
+						return false;
+					}
+				} else if (line[0] == 'M') {
+					index.files[field] = value;
+				} else {
+					return false;
+				}
+			}
+
+			return true;
+		} //parse
+
+		std::shared_ptr<const Index> get(const std::string& path) {
+			std::lock_guard<std::mutex> guard(lock);
+
+			auto found = indexes.find(path);
+			if (found != indexes.end()) {
+				return found->second;
+			}
+
+			auto index = std::make_shared<Index>();
+			index->dots = dots(path);
+			if (index->dots >= 0) {
+				std::string key = Memo::key("module index 2", FileSystem::currentDirectory() + "\n" + path, std::vector<std::string>());
+				std::string stored;
+				if (!Memo::shared().get(key, stored, true) || !parse(stored, *index)) {
+					index->files.clear();
+					Memo::shared().put(key, scan(path, *index), true);
+				}
+			}
+
+			indexes[path] = index;
+			return index;
+		} //get
+
+	public:
+		static ModuleIndex& shared() {
+			static ModuleIndex index;
+			return index;
+		} //shared
+
+		//file of module name for package.path, or an empty string if it is not indexed
+		std::string find(const std::string& path, const std::string& name) {
+			std::shared_ptr<const Index> index = get(path);
+			if (std::count(name.begin(), name.end(), '.') > index->dots) {
+				return std::string();
+			}
+			auto found = index->files.find(name);
+			return found == index->files.end() ? std::string() : found->second;
+		} //find
+
+		//forgets the indexes of this run, they are checked against the directories again on next use
+		void refresh() {
+			std::lock_guard<std::mutex> guard(lock);
+			indexes.clear();
+			FileSystem::StatCache::shared().clear();
+		} //refresh
+}; //ModuleIndex
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "luacpp.hpp"
+#include "luafile lib.hpp"
+#include "mpq.hpp"
+#include "mpq writer.hpp"
+
+/*
+*	Lua access to MPQ archives (library "mpq", userdata "MPQ.Archive")
+*
+*		mpq.open(path)				archive, or nil and a message
+*
+*		archive:read(name)			LuaFile holding the extracted file, or nil and a message
+*		archive:has(name)			true if the archive contains name
+*		archive:list()				names from the (listfile)
+*
+*		mpq.writer([archive])		new archive writer, reusing unchanged files of archive
+*
+*		writer:add(name, file)		adds a LuaFile or string
+*		writer:keep(name)			copies a file of the source archive as stored
+*		writer:compression(level)	zlib level, 1 to 9
+*		writer:write(path)			compresses and writes the archive
+*
+*	Extracted files are decompressed straight into the buffer the LuaFile spans.
+*/
+class MPQLib {
+	public:
+		static MPQ::Archive* check(Lua& lua, int index) {
+			return *(MPQ::Archive**)lua.l_checkudata(index, "MPQ.Archive");
+		} //check
+
+	private:
+		static int l_gc(Lua::State* L) {
+			Lua lua(L);
+			MPQ::Archive** archive = (MPQ::Archive**)lua.l_checkudata(1, "MPQ.Archive");
+			delete *archive;
+			*archive = nullptr;
+			return 0;
+		} //l_gc
+
+		static int l_open(Lua::State* L) {
+			Lua lua(L);
+			const char* filename = lua.l_checkstring(1);
+
+			MPQ::Archive* archive = new MPQ::Archive();
+			if (!archive->open(filename)) {
+				delete archive;
+				lua.pushnil();
+				lua.pushfstring("cannot open archive %s", filename);
+				return 2;
+			}
+
+			*(MPQ::Archive**)lua.newuserdata(sizeof(MPQ::Archive*)) = archive;
+			lua.l_getmetatable("MPQ.Archive");
+			lua.setmetatable(-2);
+			return 1;
+		} //l_open
+
+		static int l_read(Lua::State* L) {
+			Lua lua(L);
+			MPQ::Archive* archive = check(lua, 1);
+			const char* name = lua.l_checkstring(2);
+
+			IO_Helper::Data* data = archive->read(name);
+			if (data == nullptr) {
+				lua.pushnil();
+				lua.pushfstring("cannot extract %s", name);
+				return 2;
+			}
+
+			LuaFileLib::push(lua)->adopt(data, data->size);
+			return 1;
+		} //l_read
+
+		static int l_has(Lua::State* L) {
+			Lua lua(L);
+			lua.pushboolean(check(lua, 1)->has(lua.l_checkstring(2)));
+			return 1;
+		} //l_has
+
+		static int l_list(Lua::State* L) {
+			Lua lua(L);
+			std::vector<std::string> names = check(lua, 1)->list();
+
+			lua.createtable((int)names.size(), 0);
+			for (size_t i = 0; i < names.size(); ++i) {
+				lua.pushlstring(names[i].data(), names[i].size());
+				lua.rawseti(-2, (int)i + 1);
+			}
+			return 1;
+		} //l_list
+
+		static MPQ::Writer* checkWriter(Lua& lua, int index) {
+			return *(MPQ::Writer**)lua.l_checkudata(index, "MPQ.Writer");
+		} //checkWriter
+
+		static int l_writergc(Lua::State* L) {
+			Lua lua(L);
+			MPQ::Writer** writer = (MPQ::Writer**)lua.l_checkudata(1, "MPQ.Writer");
+			delete *writer;
+			*writer = nullptr;
+			return 0;
+		} //l_writergc
+
+		static int l_writer(Lua::State* L) {
+			Lua lua(L);
+			MPQ::Archive* source = lua.isnoneornil(1) ? nullptr : check(lua, 1);
+
+			MPQ::Writer* writer = new MPQ::Writer();
+			*(MPQ::Writer**)lua.newuserdata(sizeof(MPQ::Writer*)) = writer;
+			lua.l_getmetatable("MPQ.Writer");
+			lua.setmetatable(-2);
+
+			if (source != nullptr) {
+				writer->reuse(source);
+
+				//keep the source archive alive as long as the writer
+				lua.newtable();
+				lua.pushvalue(1);
+				lua.rawseti(-2, 1);
+				lua.setfenv(-2);
+			}
+
+			return 1;
+		} //l_writer
+
+		static int l_add(Lua::State* L) {
+			Lua lua(L);
+			MPQ::Writer* writer = checkWriter(lua, 1);
+			std::string name = lua.l_checkstring(2);
+
+			if (lua.type(3) == LUA_TSTRING) {
+				size_t size;
+				const char* data = lua.tolstring(3, &size);
+				writer->add(name, std::string(data, size));
+			} else {
+				writer->add(name, LuaFileLib::check(lua, 3)->file);
+			}
+
+			return 0;
+		} //l_add
+
+		static int l_keep(Lua::State* L) {
+			Lua lua(L);
+			lua.pushboolean(checkWriter(lua, 1)->keep(lua.l_checkstring(2)));
+			return 1;
+		} //l_keep
+
+		static int l_compression(Lua::State* L) {
+			Lua lua(L);
+			checkWriter(lua, 1)->compression(lua.l_checkint(2));
+			return 0;
+		} //l_compression
+
+		static int l_write(Lua::State* L) {
+			Lua lua(L);
+			const char* filename = lua.l_checkstring(2);
+
+			if (!checkWriter(lua, 1)->write(filename)) {
+				lua.pushnil();
+				lua.pushfstring("cannot write archive %s", filename);
+				return 2;
+			}
+
+			lua.pushboolean(true);
+			return 1;
+		} //l_write
+
+	public:
+		static void attach(Lua& lua) {
+			static const Lua::l_Reg methods[] = {
+				{ "read", l_read },
+				{ "has", l_has },
+				{ "list", l_list },
+				{ nullptr, nullptr }
+			};
+			static const Lua::l_Reg writerMethods[] = {
+				{ "add", l_add },
+				{ "keep", l_keep },
+				{ "compression", l_compression },
+				{ "write", l_write },
+				{ nullptr, nullptr }
+			};
+			static const Lua::l_Reg lib[] = {
+				{ "open", l_open },
+				{ "writer", l_writer },
+				{ nullptr, nullptr }
+			};
+
+			lua.l_newmetatable("MPQ.Archive");
+			lua.pushcfunction(l_gc);
+			lua.setfield(-2, "__gc");
+			lua.newtable();
+			lua.l_register(nullptr, methods);
+			lua.setfield(-2, "__index");
+			lua.pop(1);
+
+			lua.l_newmetatable("MPQ.Writer");
+			lua.pushcfunction(l_writergc);
+			lua.setfield(-2, "__gc");
+			lua.newtable();
+			lua.l_register(nullptr, writerMethods);
+			lua.setfield(-2, "__index");
+			lua.pop(1);
+
+			lua.l_register("mpq", lib);
+			lua.pop(1);
+		} //attach
+}; //MPQLib
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cctype>
+#include <stdint.h>
+
+#include "zlib.h"
+
+#include "mpq.hpp"
+#include "luafile.hpp"
+#include "thread pool.hpp"
+#include "trace.hpp"
+
+namespace MPQ {
+	/*
+	*	Writer
+	*
+	*	Builds an MPQ archive from in memory files. Sectors of every file are compressed
+	*	with zlib across the shared thread pool, then the header, files, hash table and
+	*	block table are written in a single pass.
+	*
+	*	With a source archive set, an added file whose contents match the file of the same
+	*	name in the source is copied as stored, without compressing it again, and keep
+	*	copies a file over unchanged. The bytes in front of the source archive (the HM3W
+	*	map header) are written in front of the new one.
+	*
+	*	A (listfile) naming every file is added unless one is given. An (attributes) file,
+	*	kept from the source or added, is rebuilt for the new block table: version 100 with
+	*	the CRC32 of each block, 0 where it is not known (blocks kept as stored from a source
+	*	without CRCs, and the (attributes) block itself).
+	*/
+	class Writer {
+		private:
+			struct Entry {
+				std::string name;
+				std::string data;		//contents, when not copied from the source
+				bool copied;
+				uint32_t crc;			//of the contents, 0 if unknown
+				BlockEntry block;
+				std::vector<char> stored;
+				std::vector<std::string> sectors;
+			};
+
+			std::vector<Entry> entries;
+			std::map<std::string, size_t> index;
+
+			Archive* source;
+			std::vector<uint32_t> crcs;		//of the source blocks, from its (attributes)
+			std::vector<char> head;
+			uint32_t sectorShift;
+			int level;
+
+			static std::string key(const std::string& name) {
+				std::string key = name;
+				for (auto& c : key) {
+					c = c == '/' ? '\\' : (char)toupper((unsigned char)c);
+				}
+				return key;
+			} //key
+
+			Entry& entry(const std::string& name) {
+				auto found = index.find(key(name));
+				if (found != index.end()) {
+					Entry& entry = entries[found->second];
+					entry = Entry();
+					entry.name = name;
+					return entry;
+				}
+
+				index[key(name)] = entries.size();
+				entries.push_back(Entry());
+				entries.back().name = name;
+				return entries.back();
+			} //entry
+
+			//copies the stored block of name from the source, if its key does not depend on its position
+			bool copy(Entry& entry) {
+				const BlockEntry* block = source != nullptr ? source->find(entry.name.c_str()) : nullptr;
+				if (block == nullptr || (block->flags & FILE_FIX_KEY) || !source->raw(*block, entry.stored)) {
+					return false;
+				}
+
+				size_t i = source->indexOf(*block);
+				entry.copied = true;
+				entry.crc = i < crcs.size() ? crcs[i] : 0;
+				entry.block = *block;
+				return true;
+			} //copy
+
+			//true if the source holds the same contents for the entry, decided by size first, then
+			//by the CRC32 of the source (attributes) and otherwise sector by sector
+			bool unchanged(const Entry& entry) {
+				const BlockEntry* block = source != nullptr ? source->find(entry.name.c_str()) : nullptr;
+				if (block == nullptr || block->size != entry.data.size() || (block->flags & FILE_FIX_KEY)) {
+					return false;
+				}
+
+				size_t i = source->indexOf(*block);
+				if (i < crcs.size() && crcs[i] != 0) {
+					return crcs[i] == entry.crc;
+				}
+				return source->matches(entry.name.c_str(), entry.data.data(), entry.data.size());
+			} //unchanged
+
+			//(attributes) with the CRC32 of every entry, in block order
+			std::string attributes() const {
+				std::vector<uint32_t> table(2 + entries.size());
+				table[0] = 100;
+				table[1] = 1;
+				for (size_t i = 0; i < entries.size(); ++i) {
+					table[2 + i] = entries[i].crc;
+				}
+				return std::string((const char*)&table[0], table.size() * 4);
+			} //attributes
+
+			void compress(Entry& entry, size_t sector) {
+				uint32_t sectorSize = 512u << sectorShift;
+				const char* raw = entry.data.data() + sector * sectorSize;
+				size_t size = entry.data.size() - sector * sectorSize;
+				if (size > sectorSize) {
+					size = sectorSize;
+				}
+
+				std::string& out = entry.sectors[sector];
+				uLongf bound = compressBound((uLong)size);
+				out.resize(bound + 1);
+				out[0] = (char)COMPRESSION_ZLIB;
+
+				if (compress2((Bytef*)&out[1], &bound, (const Bytef*)raw, (uLong)size, level) != Z_OK || bound + 1 >= size) {
+					//not worth it, sectors as large as the input are read as stored
+					out.assign(raw, size);
+				} else {
+					out.resize(bound + 1);
+				}
+			} //compress
+
+			//assembles the sector offset table and sectors of a compressed entry
+			static void assemble(Entry& entry) {
+				size_t count = entry.sectors.size();
+				std::vector<uint32_t> offsets(count + 1);
+				offsets[0] = (uint32_t)(offsets.size() * 4);
+				for (size_t i = 0; i < count; ++i) {
+					offsets[i + 1] = offsets[i] + (uint32_t)entry.sectors[i].size();
+				}
+
+				entry.stored.resize(offsets[count]);
+				memcpy(&entry.stored[0], &offsets[0], offsets.size() * 4);
+				for (size_t i = 0; i < count; ++i) {
+					std::copy(entry.sectors[i].begin(), entry.sectors[i].end(), entry.stored.begin() + offsets[i]);
+				}
+				entry.sectors.clear();
+
+				entry.block.compressedSize = offsets[count];
+				entry.block.size = (uint32_t)entry.data.size();
+				entry.block.flags = FILE_EXISTS | FILE_COMPRESS;
+			} //assemble
+
+			template <class T>
+			static void writeTable(std::ostream& out, std::vector<T>& table, const char* keyName) {
+				encrypt((uint32_t*)&table[0], table.size() * sizeof(T) / 4, hash(keyName, HASH_FILE_KEY));
+				out.write((const char*)&table[0], table.size() * sizeof(T));
+			} //writeTable
+
+		public:
+			Writer() : source(nullptr), sectorShift(3), level(Z_DEFAULT_COMPRESSION) { }
+
+			//archive to copy unchanged files and the map header from, must outlive the writer
+			void reuse(Archive* archive) {
+				source = archive;
+				sectorShift = 0;
+				while ((512u << sectorShift) < archive->sectorBytes()) {
+					++sectorShift;
+				}
+				archive->prefix(head);
+				crcs.clear();
+				archive->attributes(crcs);
+			} //reuse
+
+			//zlib level, 1 (fast) to 9 (small)
+			void compression(int value) { level = value; }
+
+			void add(const std::string& name, std::string data) {
+				Entry& added = entry(name);
+				added.copied = false;
+				added.crc = 0;
+				added.data.swap(data);
+			} //add
+
+			void add(const std::string& name, const LuaFile& file) {
+				std::string data;
+				data.reserve(file.size());
+				file.each([&data](const char* start, size_t size) {
+					data.append(start, size);
+				});
+				add(name, std::move(data));
+			} //add
+
+			//copies a file from the source archive as stored, returns false if it cannot
+			//a file added before under name stays as it was when keep fails
+			bool keep(const std::string& name) {
+				Entry kept;
+				kept.name = name;
+				if (!copy(kept)) {
+					IO_Helper::Data* data = source != nullptr ? source->read(name.c_str()) : nullptr;
+					if (data == nullptr) {
+						return false;
+					}
+					kept.copied = false;
+					kept.crc = 0;
+					kept.data.assign(data->str, data->size);
+					delete data;
+				}
+
+				entry(name) = std::move(kept);
+				return true;
+			} //keep
+
+			bool write(const char* filename) {
+				Trace::Scope scope("mpq", "write", filename);
+
+				if (index.find(key("(listfile)")) == index.end()) {
+					std::string listfile;
+					for (auto& entry : entries) {
+						listfile += entry.name + "\r\n";
+					}
+					add("(listfile)", listfile);
+				}
+
+				//the old one lists the blocks of the source, it is rebuilt once the CRCs are known
+				bool rebuild = index.find(key("(attributes)")) != index.end();
+				if (rebuild) {
+					add("(attributes)", std::string());
+				}
+
+				//files the source already holds unchanged are copied as stored
+				ThreadPool::shared().forEach(entries.size(), [this](size_t i) {
+					Entry& entry = entries[i];
+					if (entry.copied) {
+						return;
+					}
+					entry.crc = entry.data.empty() ? 0 : (uint32_t)crc32(crc32(0, Z_NULL, 0), (const Bytef*)entry.data.data(), (uInt)entry.data.size());
+					uint32_t crc = entry.crc;
+					if (source != nullptr && unchanged(entry) && copy(entry)) {
+						entry.crc = crc;
+					}
+				});
+
+				if (rebuild) {
+					std::string table = attributes();
+					add("(attributes)", table);
+				}
+
+				//compress every sector of every other file across the pool
+				uint32_t sectorSize = 512u << sectorShift;
+				std::vector<std::pair<size_t, size_t>> jobs;
+				for (size_t i = 0; i < entries.size(); ++i) {
+					Entry& entry = entries[i];
+					if (entry.copied || entry.data.empty()) {
+						continue;
+					}
+					entry.sectors.resize((entry.data.size() + sectorSize - 1) / sectorSize);
+					for (size_t j = 0; j < entry.sectors.size(); ++j) {
+						jobs.push_back(std::make_pair(i, j));
+					}
+				}
+				ThreadPool::shared().forEach(jobs.size(), [this, &jobs](size_t i) {
+					compress(entries[jobs[i].first], jobs[i].second);
+				});
+
+				for (auto& entry : entries) {
+					if (entry.copied) {
+						continue;
+					}
+					if (entry.data.empty()) {
+						entry.block.compressedSize = 0;
+						entry.block.size = 0;
+						entry.block.flags = FILE_EXISTS;
+					} else {
+						assemble(entry);
+					}
+				}
+
+				//layout: header, files, hash table, block table
+				uint32_t offset = 32;
+				std::vector<BlockEntry> blocks;
+				for (auto& entry : entries) {
+					entry.block.offset = offset;
+					offset += entry.block.compressedSize;
+					blocks.push_back(entry.block);
+				}
+
+				uint32_t hashCount = 16;
+				while (hashCount < entries.size() * 4 / 3 + 1) {
+					hashCount <<= 1;
+				}
+				std::vector<HashEntry> hashes(hashCount);
+				for (auto& entry : hashes) {
+					entry.name1 = entry.name2 = HASH_EMPTY;
+					entry.locale = entry.platform = 0xFFFF;
+					entry.block = HASH_EMPTY;
+				}
+				for (size_t i = 0; i < entries.size(); ++i) {
+					const char* name = entries[i].name.c_str();
+					uint32_t slot = hash(name, HASH_TABLE_OFFSET) & (hashCount - 1);
+					while (hashes[slot].block != HASH_EMPTY) {
+						slot = (slot + 1) & (hashCount - 1);
+					}
+					hashes[slot].name1 = hash(name, HASH_NAME_A);
+					hashes[slot].name2 = hash(name, HASH_NAME_B);
+					hashes[slot].locale = 0;
+					hashes[slot].platform = 0;
+					hashes[slot].block = (uint32_t)i;
+				}
+
+				uint32_t hashTable = offset;
+				uint32_t blockTable = hashTable + hashCount * sizeof(HashEntry);
+				uint32_t size = blockTable + (uint32_t)(blocks.size() * sizeof(BlockEntry));
+
+				std::ofstream out(filename, std::ios::binary);
+				if (!out.is_open()) {
+					return false;
+				}
+
+				if (!head.empty()) {
+					out.write(&head[0], head.size());
+				}
+
+				uint32_t header[8] = { 0x1A51504D, 32, size, (uint32_t)sectorShift << 16, hashTable, blockTable, hashCount, (uint32_t)blocks.size() };
+				out.write((const char*)header, sizeof(header));
+
+				for (auto& entry : entries) {
+					if (!entry.stored.empty()) {
+						out.write(&entry.stored[0], entry.stored.size());
+					}
+				}
+
+				writeTable(out, hashes, "(hash table)");
+				if (!blocks.empty()) {
+					writeTable(out, blocks, "(block table)");
+				}
+
+				return !out.fail();
+			} //write
+	}; //Writer
+} //MPQ
@@ -0,0 +1,505 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <new>
+#include <mutex>
+#include <cctype>
+#include <cstring>
+#include <stdint.h>
+
+#include "zlib.h"
+#include "bzlib.h"
+
+#include "io helper.hpp"
+#include "thread pool.hpp"
+#include "trace.hpp"
+
+/*
+*	MPQ
+*
+*	Reader for MPQ archives (.w3x, .w3m) as used by Warcraft III: hash table lookup,
+*	block table, sector offset tables, file keys and zlib/bzip2 sector compression.
+*
+*	Files are extracted straight into memory buffers. Large files have their sectors
+*	decompressed in parallel on the shared thread pool.
+*
+*	PKWARE implode, Huffman and ADPCM compressed files are not supported.
+*/
+namespace MPQ {
+	enum {
+		FILE_IMPLODE = 0x00000100,
+		FILE_COMPRESS = 0x00000200,
+		FILE_ENCRYPTED = 0x00010000,
+		FILE_FIX_KEY = 0x00020000,
+		FILE_SINGLE_UNIT = 0x01000000,
+		FILE_SECTOR_CRC = 0x04000000,
+		FILE_EXISTS = 0x80000000
+	};
+
+	enum {
+		COMPRESSION_ZLIB = 0x02,
+		COMPRESSION_BZIP2 = 0x10
+	};
+
+	enum {
+		HASH_TABLE_OFFSET = 0,
+		HASH_NAME_A = 1,
+		HASH_NAME_B = 2,
+		HASH_FILE_KEY = 3
+	};
+
+	static const uint32_t HASH_EMPTY = 0xFFFFFFFF;
+	static const uint32_t HASH_DELETED = 0xFFFFFFFE;
+
+	struct HashEntry {
+		uint32_t name1;
+		uint32_t name2;
+		uint16_t locale;
+		uint16_t platform;
+		uint32_t block;
+	};
+
+	struct BlockEntry {
+		uint32_t offset;
+		uint32_t compressedSize;
+		uint32_t size;
+		uint32_t flags;
+	};
+
+	inline const uint32_t* cryptTable() {
+		static uint32_t table[0x500];
+		static std::once_flag once;
+
+		std::call_once(once, [] {
+			uint32_t seed = 0x00100001;
+			for (uint32_t index1 = 0; index1 < 0x100; ++index1) {
+				for (uint32_t index2 = index1, i = 0; i < 5; ++i, index2 += 0x100) {
+					seed = (seed * 125 + 3) % 0x2AAAAB;
+					uint32_t high = (seed & 0xFFFF) << 0x10;
+					seed = (seed * 125 + 3) % 0x2AAAAB;
+					table[index2] = high | (seed & 0xFFFF);
+				}
+			}
+		});
+
+		return table;
+	} //cryptTable
+
+	//hashes a file name, case insensitive and treating / as a path separator
+	inline uint32_t hash(const char* s, uint32_t type) {
+		const uint32_t* table = cryptTable();
+		uint32_t seed1 = 0x7FED7FED;
+		uint32_t seed2 = 0xEEEEEEEE;
+
+		for (; *s != 0; ++s) {
+			uint32_t c = (uint32_t)toupper((unsigned char)*s);
+			if (c == '/') {
+				c = '\\';
+			}
+			seed1 = table[(type << 8) + c] ^ (seed1 + seed2);
+			seed2 = c + seed1 + seed2 + (seed2 << 5) + 3;
+		}
+
+		return seed1;
+	} //hash
+
+	inline void decrypt(uint32_t* data, size_t count, uint32_t key) {
+		const uint32_t* table = cryptTable();
+		uint32_t seed = 0xEEEEEEEE;
+
+		for (size_t i = 0; i < count; ++i) {
+			seed += table[0x400 + (key & 0xFF)];
+			uint32_t c = data[i] ^ (key + seed);
+			key = ((~key << 0x15) + 0x11111111) | (key >> 0x0B);
+			seed = c + seed + (seed << 5) + 3;
+			data[i] = c;
+		}
+	} //decrypt
+
+	inline void encrypt(uint32_t* data, size_t count, uint32_t key) {
+		const uint32_t* table = cryptTable();
+		uint32_t seed = 0xEEEEEEEE;
+
+		for (size_t i = 0; i < count; ++i) {
+			seed += table[0x400 + (key & 0xFF)];
+			uint32_t c = data[i];
+			data[i] = c ^ (key + seed);
+			key = ((~key << 0x15) + 0x11111111) | (key >> 0x0B);
+			seed = c + seed + (seed << 5) + 3;
+		}
+	} //encrypt
+
+	//encryption key of a file from its name and block
+	inline uint32_t fileKey(const char* name, const BlockEntry& block) {
+		const char* base = name;
+		for (const char* c = name; *c != 0; ++c) {
+			if (*c == '\\' || *c == '/') {
+				base = c + 1;
+			}
+		}
+
+		uint32_t key = hash(base, HASH_FILE_KEY);
+		if (block.flags & FILE_FIX_KEY) {
+			key = (key + block.offset) ^ block.size;
+		}
+		return key;
+	} //fileKey
+
+	//decompresses one sector, the first byte is the compression mask
+	inline bool decompress(const char* in, size_t inSize, char* out, size_t outSize) {
+		if (inSize == 0) {
+			return false;
+		}
+
+		unsigned char mask = (unsigned char)in[0];
+		if (mask == COMPRESSION_ZLIB) {
+			uLongf size = (uLongf)outSize;
+			return uncompress((Bytef*)out, &size, (const Bytef*)in + 1, (uLong)inSize - 1) == Z_OK && size == outSize;
+		}
+		if (mask == COMPRESSION_BZIP2) {
+			unsigned int size = (unsigned int)outSize;
+			return BZ2_bzBuffToBuffDecompress(out, &size, const_cast<char*>(in) + 1, (unsigned int)inSize - 1, 0, 0) == BZ_OK && size == outSize;
+		}
+
+		return false;
+	} //decompress
+
+	class Archive {
+		private:
+			std::ifstream file;
+			std::mutex lock;
+
+			uint64_t base;		//offset of the archive in the file
+			uint64_t length;	//bytes of the file from base on
+			uint32_t sectorSize;
+
+			std::vector<HashEntry> hashes;
+			std::vector<BlockEntry> blocks;
+
+			bool readAt(uint64_t offset, void* buffer, size_t size) {
+				std::lock_guard<std::mutex> guard(lock);
+				file.clear();
+				file.seekg((std::streamoff)offset);
+				file.read((char*)buffer, size);
+				return (size_t)file.gcount() == size;
+			} //readAt
+
+			template <class T>
+			bool readTable(uint64_t offset, uint32_t count, const char* keyName, std::vector<T>& table) {
+				table.resize(count);
+				if (count == 0) {
+					return true;
+				}
+				if (!readAt(base + offset, &table[0], count * sizeof(T))) {
+					return false;
+				}
+				decrypt((uint32_t*)&table[0], count * sizeof(T) / 4, hash(keyName, HASH_FILE_KEY));
+				return true;
+			} //readTable
+
+			//decompresses or decrypts sector i of a file from its raw block data
+			bool sector(const BlockEntry& block, uint32_t key, const char* raw, const uint32_t* offsets, size_t i, char* out, size_t outSize) {
+				uint32_t start = offsets[i];
+				uint32_t end = offsets[i + 1];
+				if (end < start || end > block.compressedSize) {
+					return false;
+				}
+
+				size_t size = end - start;
+				std::vector<char> data(raw + start, raw + end);
+
+				if (block.flags & FILE_ENCRYPTED) {
+					decrypt((uint32_t*)data.data(), size / 4, key + (uint32_t)i);
+				}
+
+				if (size < outSize) {
+					return (block.flags & FILE_COMPRESS) && decompress(data.data(), size, out, outSize);
+				}
+				if (size != outSize) {
+					return false;
+				}
+
+				std::copy(data.begin(), data.end(), out);
+				return true;
+			} //sector
+
+		public:
+			Archive() : base(0), length(0), sectorSize(4096) { }
+
+			bool open(const char* filename) {
+				Trace::Scope scope("mpq", "open", filename);
+
+				file.open(filename, std::ios::binary);
+				if (!file.is_open()) {
+					return false;
+				}
+				file.seekg(0, std::ios::end);
+				uint64_t fileSize = (uint64_t)file.tellg();
+
+				//the header is on a 512 byte boundary, possibly behind a user data block
+				uint32_t header[8];
+				for (uint64_t offset = 0; ; offset += 0x200) {
+					if (!readAt(offset, header, sizeof(header))) {
+						return false;
+					}
+					if (header[0] == 0x1B51504D) {
+						offset += header[2];
+						if (!readAt(offset, header, sizeof(header)) || header[0] != 0x1A51504D) {
+							return false;
+						}
+					}
+					if (header[0] == 0x1A51504D) {
+						base = offset;
+						break;
+					}
+				}
+
+				length = fileSize - base;
+
+				uint16_t shift = (uint16_t)(header[3] >> 16);
+				if (shift > 15) {
+					return false;
+				}
+				sectorSize = 512u << shift;
+
+				uint32_t hashTable = header[4];
+				uint32_t blockTable = header[5];
+				uint32_t hashCount = header[6];
+				uint32_t blockCount = header[7];
+
+				//sizes come from the header, check them against the file before allocating
+				if (hashCount == 0 || (hashCount & (hashCount - 1)) != 0) {
+					return false;
+				}
+				if (hashTable > length || (uint64_t)hashCount * sizeof(HashEntry) > length - hashTable) {
+					return false;
+				}
+				if (blockTable > length) {
+					return false;
+				}
+				//protected maps overstate the block count, keep the entries the file holds
+				if ((uint64_t)blockCount * sizeof(BlockEntry) > length - blockTable) {
+					blockCount = (uint32_t)((length - blockTable) / sizeof(BlockEntry));
+				}
+
+				return readTable(hashTable, hashCount, "(hash table)", hashes) && readTable(blockTable, blockCount, "(block table)", blocks);
+			} //open
+
+			uint32_t sectorBytes() const { return sectorSize; }
+
+			//reads the bytes in front of the archive, the HM3W header of a map
+			bool prefix(std::vector<char>& out) {
+				out.resize((size_t)base);
+				return base == 0 || readAt(0, &out[0], (size_t)base);
+			} //prefix
+
+			const std::vector<HashEntry>& hashTable() const { return hashes; }
+			const std::vector<BlockEntry>& blockTable() const { return blocks; }
+
+			//returns the block of a file, or nullptr if the archive does not have it
+			const BlockEntry* find(const char* name) const {
+				if (hashes.empty()) {
+					return nullptr;
+				}
+
+				uint32_t mask = (uint32_t)hashes.size() - 1;
+				uint32_t start = hash(name, HASH_TABLE_OFFSET) & mask;
+				uint32_t name1 = hash(name, HASH_NAME_A);
+				uint32_t name2 = hash(name, HASH_NAME_B);
+
+				for (uint32_t i = start; ; ) {
+					const HashEntry& entry = hashes[i];
+					if (entry.block == HASH_EMPTY) {
+						return nullptr;
+					}
+					if (entry.name1 == name1 && entry.name2 == name2 && entry.block < blocks.size() && (blocks[entry.block].flags & FILE_EXISTS)) {
+						return &blocks[entry.block];
+					}
+
+					i = (i + 1) & mask;
+					if (i == start) {
+						return nullptr;
+					}
+				}
+			} //find
+
+			bool has(const char* name) const { return find(name) != nullptr; }
+
+			//reads the stored bytes of a block without decoding them
+			bool raw(const BlockEntry& block, std::vector<char>& out) {
+				if (block.offset > length || block.compressedSize > length - block.offset) {
+					return false;
+				}
+				out.resize(block.compressedSize);
+				return block.compressedSize == 0 || readAt(base + block.offset, &out[0], block.compressedSize);
+			} //raw
+
+			//sector offsets of a block read with raw, false if the block is malformed
+			bool offsets(const BlockEntry& block, uint32_t key, const std::vector<char>& data, std::vector<uint32_t>& out) const {
+				if (block.flags & FILE_SINGLE_UNIT) {
+					out.assign(1, 0);
+					out.push_back(block.compressedSize);
+					return true;
+				}
+
+				size_t count = (block.size + sectorSize - 1) / sectorSize;
+				out.resize(count + 1);
+
+				if (block.flags & FILE_COMPRESS) {
+					if (data.size() < out.size() * 4) {
+						return false;
+					}
+					memcpy(&out[0], data.data(), out.size() * 4);
+					if (block.flags & FILE_ENCRYPTED) {
+						decrypt(&out[0], out.size(), key - 1);
+					}
+				} else {
+					if (block.size > block.compressedSize) {
+						return false;
+					}
+					for (size_t i = 0; i <= count; ++i) {
+						out[i] = (uint32_t)(i * sectorSize < block.size ? i * sectorSize : block.size);
+					}
+				}
+				return true;
+			} //offsets
+
+			//extracts a file into a new buffer, returns nullptr on failure
+			IO_Helper::Data* read(const char* name) {
+				Trace::Scope scope("mpq", "read", name);
+
+				const BlockEntry* entry = find(name);
+				if (entry == nullptr || (entry->flags & FILE_IMPLODE)) {
+					return nullptr;
+				}
+				const BlockEntry& block = *entry;
+
+				std::vector<char> data;
+				std::vector<uint32_t> sectors;
+				uint32_t key = (block.flags & FILE_ENCRYPTED) ? fileKey(name, block) : 0;
+				if (!raw(block, data) || !offsets(block, key, data, sectors)) {
+					return nullptr;
+				}
+
+				//sizes of a corrupt block can still be far off, fail instead of throwing
+				char* str = new (std::nothrow) char[(size_t)block.size + 1];
+				if (str == nullptr) {
+					return nullptr;
+				}
+				IO_Helper::Data* out = new IO_Helper::Data();
+				out->size = block.size;
+				out->str = str;
+				out->str[block.size] = 0;
+
+				bool ok = true;
+
+				if (block.flags & FILE_SINGLE_UNIT) {
+					ok = sector(block, key, data.data(), &sectors[0], 0, out->str, block.size);
+				} else {
+					size_t count = sectors.size() - 1;
+					std::vector<char> failed(count, 0);
+					auto decode = [&](size_t i) {
+						size_t size = i + 1 < count ? sectorSize : block.size - i * sectorSize;
+						failed[i] = !sector(block, key, data.data(), &sectors[0], i, out->str + i * sectorSize, size);
+					};
+
+					if (count >= 8) {
+						ThreadPool::shared().forEach(count, decode);
+					} else {
+						for (size_t i = 0; i < count; ++i) {
+							decode(i);
+						}
+					}
+
+					for (auto f : failed) {
+						ok = ok && !f;
+					}
+				}
+
+				if (!ok) {
+					delete out;
+					return nullptr;
+				}
+				return out;
+			} //read
+
+			//true if the file holds exactly [data, data + size), decodes one sector at a time
+			//and stops at the first one that differs
+			bool matches(const char* name, const char* data, size_t size) {
+				const BlockEntry* entry = find(name);
+				if (entry == nullptr || entry->size != size || (entry->flags & FILE_IMPLODE)) {
+					return false;
+				}
+				const BlockEntry& block = *entry;
+
+				std::vector<char> stored;
+				std::vector<uint32_t> sectors;
+				uint32_t key = (block.flags & FILE_ENCRYPTED) ? fileKey(name, block) : 0;
+				if (!raw(block, stored) || !offsets(block, key, stored, sectors)) {
+					return false;
+				}
+
+				size_t unit = (block.flags & FILE_SINGLE_UNIT) ? block.size : sectorSize;
+				std::vector<char> buffer(unit);
+				for (size_t i = 0; i + 1 < sectors.size(); ++i) {
+					size_t length = i + 2 < sectors.size() ? unit : block.size - i * unit;
+					if (length > 0 && (!sector(block, key, stored.data(), &sectors[0], i, buffer.data(), length) || memcmp(buffer.data(), data + i * unit, length) != 0)) {
+						return false;
+					}
+				}
+				return true;
+			} //matches
+
+			//CRC32 of each block from the (attributes) file, false if the archive has none
+			bool attributes(std::vector<uint32_t>& crcs) {
+				IO_Helper::Data* data = read("(attributes)");
+				if (data == nullptr) {
+					return false;
+				}
+
+				//version 100, flags, then a CRC32 for each block when flags has bit 1
+				uint32_t header[2] = { 0, 0 };
+				size_t count = blocks.size();
+				bool ok = data->size >= 8 + count * 4;
+				if (ok) {
+					memcpy(header, data->str, 8);
+					ok = header[0] == 100 && (header[1] & 1) != 0;
+				}
+				if (ok) {
+					crcs.resize(count);
+					memcpy(crcs.data(), data->str + 8, count * 4);
+				}
+				delete data;
+				return ok;
+			} //attributes
+
+			//index of a block found with find in blockTable()
+			size_t indexOf(const BlockEntry& block) const { return &block - &blocks[0]; }
+
+			//names from the (listfile), if the archive has one
+			std::vector<std::string> list() {
+				std::vector<std::string> names;
+
+				IO_Helper::Data* listfile = read("(listfile)");
+				if (listfile == nullptr) {
+					return names;
+				}
+
+				const char* line = listfile->str;
+				const char* end = listfile->str + listfile->size;
+				for (const char* c = line; c <= end; ++c) {
+					if (c == end || *c == '\r' || *c == '\n' || *c == ';') {
+						if (c > line) {
+							names.push_back(std::string(line, c));
+						}
+						line = c + 1;
+					}
+				}
+
+				delete listfile;
+				return names;
+			} //list
+	}; //Archive
+} //MPQ
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+
+#include "luacpp.hpp"
+#include "object data.hpp"
+
+/*
+*	Lua access to ObjectData (library "objdata", userdata "ObjectData")
+*
+*		objdata.open(path [, kind])		kind defaults to the extension of path
+*		objdata.new(kind)				empty file of kind ("w3u", "w3a", ...)
+*
+*		data:get(id, field [, level])	value and type name, or nil
+*		data:set(id, field, value [, level [, type [, pointer]]])
+*		data:unset(id, field [, level])
+*		data:create(id, base)			new custom object
+*		data:remove(id)
+*		data:objects([custom])			ids of the original or custom objects
+*		data:batch(edits)				many edits in one call
+*		data:save(path)
+*
+*	Ids and fields are 4 character rawcodes. A new modification takes its type from type
+*	("int", "real", "unreal", "string") or else from the value, an existing one keeps
+*	its type.
+*
+*	batch takes a table of objects, each a table of fields; a field is a value or a table
+*	of values by level. An object with a base entry is created if it does not exist.
+*
+*		data:batch{
+*			A000 = { base = "AHbz", anam = "Blizzard", Hbz1 = { 20, 30, 40 } },
+*		}
+*/
+class ObjectDataLib {
+	private:
+		static ObjectData* check(Lua& lua, int index) {
+			return *(ObjectData**)lua.l_checkudata(index, "ObjectData");
+		} //check
+
+		static uint32_t rawcode(Lua& lua, int index) {
+			size_t size;
+			const char* s = lua.l_checklstring(index, &size);
+			lua.l_argcheck(size == 4, index, "rawcode expected");
+			return ObjectData::id(s);
+		} //rawcode
+
+		static void push(Lua& lua, ObjectData* data) {
+			*(ObjectData**)lua.newuserdata(sizeof(ObjectData*)) = data;
+			lua.l_getmetatable("ObjectData");
+			lua.setmetatable(-2);
+		} //push
+
+		//sets field from the value at index, returns false if the object does not exist
+		static bool set(Lua& lua, ObjectData& data, uint32_t id, uint32_t field, int index, int32_t level, const char* type, int32_t pointer) {
+			static const char* types[] = { "int", "real", "unreal", "string", nullptr };
+
+			int32_t kind = -1;
+			if (type != nullptr) {
+				for (int i = 0; types[i] != nullptr; ++i) {
+					if (strcmp(type, types[i]) == 0) {
+						kind = i;
+					}
+				}
+			}
+			if (kind == -1) {
+				const ObjectData::Mod* mod = data.get(id, field, level);
+				if (mod != nullptr) {
+					kind = mod->type;
+				} else if (lua.type(index) == LUA_TSTRING) {
+					kind = ObjectData::STRING;
+				} else if (lua.type(index) == LUA_TNUMBER && std::floor(lua.tonumber(index)) != lua.tonumber(index)) {
+					kind = ObjectData::REAL;
+				} else {
+					kind = ObjectData::INT;
+				}
+			}
+
+			int32_t integer = 0;
+			float real = 0;
+			std::string text;
+			switch (kind) {
+				case ObjectData::INT:
+					integer = lua.type(index) == LUA_TBOOLEAN ? lua.toboolean(index) : (int32_t)lua.tointeger(index);
+					break;
+				case ObjectData::REAL:
+				case ObjectData::UNREAL:
+					real = (float)lua.tonumber(index);
+					break;
+				default:
+					if (lua.isstring(index)) {
+						size_t size;
+						const char* s = lua.tolstring(index, &size);
+						text.assign(s, size);
+					}
+			}
+
+			return data.set(id, field, level, kind, integer, real, text, pointer);
+		} //set
+
+		static int l_gc(Lua::State* L) {
+			Lua lua(L);
+			ObjectData** data = (ObjectData**)lua.l_checkudata(1, "ObjectData");
+			delete *data;
+			*data = nullptr;
+			return 0;
+		} //l_gc
+
+		static int l_open(Lua::State* L) {
+			Lua lua(L);
+			std::string filename = lua.l_checkstring(1);
+			std::string kind = filename.size() > 3 ? filename.substr(filename.size() - 3) : "";
+			kind = lua.l_optstring(2, kind.c_str());
+
+			ObjectData* data = new ObjectData(kind);
+			if (!data->open(filename.c_str())) {
+				lua.pushnil();
+				lua.pushstring(data->error().c_str());
+				delete data;
+				return 2;
+			}
+
+			push(lua, data);
+			return 1;
+		} //l_open
+
+		static int l_new(Lua::State* L) {
+			Lua lua(L);
+			push(lua, new ObjectData(lua.l_checkstring(1)));
+			return 1;
+		} //l_new
+
+		static int l_get(Lua::State* L) {
+			Lua lua(L);
+			static const char* types[] = { "int", "real", "unreal", "string" };
+
+			const ObjectData::Mod* mod = check(lua, 1)->get(rawcode(lua, 2), rawcode(lua, 3), lua.l_optint(4, 0));
+			if (mod == nullptr) {
+				lua.pushnil();
+				return 1;
+			}
+
+			switch (mod->type) {
+				case ObjectData::INT: lua.pushinteger(mod->integer); break;
+				case ObjectData::REAL:
+				case ObjectData::UNREAL: lua.pushnumber(mod->real); break;
+				default: lua.pushlstring(mod->text.data(), mod->text.size());
+			}
+			lua.pushstring(types[mod->type]);
+			return 2;
+		} //l_get
+
+		static int l_set(Lua::State* L) {
+			Lua lua(L);
+			lua.l_checkany(4);
+			lua.pushboolean(set(lua, *check(lua, 1), rawcode(lua, 2), rawcode(lua, 3), 4, lua.l_optint(5, 0), lua.l_optstring(6, nullptr), lua.l_optint(7, 0)));
+			return 1;
+		} //l_set
+
+		static int l_unset(Lua::State* L) {
+			Lua lua(L);
+			lua.pushboolean(check(lua, 1)->unset(rawcode(lua, 2), rawcode(lua, 3), lua.l_optint(4, 0)));
+			return 1;
+		} //l_unset
+
+		static int l_create(Lua::State* L) {
+			Lua lua(L);
+			lua.pushboolean(check(lua, 1)->create(rawcode(lua, 2), rawcode(lua, 3)));
+			return 1;
+		} //l_create
+
+		static int l_remove(Lua::State* L) {
+			Lua lua(L);
+			lua.pushboolean(check(lua, 1)->remove(rawcode(lua, 2)));
+			return 1;
+		} //l_remove
+
+		static int l_objects(Lua::State* L) {
+			Lua lua(L);
+			std::vector<uint32_t> ids = check(lua, 1)->objects(lua.toboolean(2) ? 1 : 0);
+
+			lua.createtable((int)ids.size(), 0);
+			for (size_t i = 0; i < ids.size(); ++i) {
+				lua.pushlstring(ObjectData::rawcode(ids[i]).c_str(), 4);
+				lua.rawseti(-2, (int)i + 1);
+			}
+			return 1;
+		} //l_objects
+
+		static int l_batch(Lua::State* L) {
+			Lua lua(L);
+			ObjectData& data = *check(lua, 1);
+			lua.l_checktype(2, LUA_TTABLE);
+			lua.settop(2);
+
+			int edits = 0;
+			lua.pushnil();
+			while (lua.next(2)) {
+				//converting a number key to a string in place would break next
+				if (lua.type(3) != LUA_TSTRING) {
+					return lua.l_error("batch expects rawcode keys");
+				}
+				uint32_t id = rawcode(lua, 3);
+				lua.l_checktype(4, LUA_TTABLE);
+
+				lua.getfield(4, "base");
+				if (lua.isstring(-1)) {
+					data.create(id, rawcode(lua, 5));
+				}
+				lua.pop(1);
+
+				lua.pushnil();
+				while (lua.next(4)) {
+					//stack: 5 field, 6 value
+					if (lua.type(5) != LUA_TSTRING) {
+						lua.pop(1);
+						continue;
+					}
+					size_t size;
+					const char* field = lua.tolstring(5, &size);
+					if (size != 4 || strcmp(field, "base") == 0) {
+						lua.pop(1);
+						continue;
+					}
+
+					bool ok = true;
+					if (lua.istable(6)) {
+						lua.pushnil();
+						while (lua.next(6)) {
+							ok = set(lua, data, id, ObjectData::id(field), 8, (int32_t)lua.tointeger(7), nullptr, 0) && ok;
+							++edits;
+							lua.pop(1);
+						}
+					} else {
+						ok = set(lua, data, id, ObjectData::id(field), 6, 0, nullptr, 0);
+						++edits;
+					}
+					if (!ok) {
+						return lua.l_error("object %s does not exist", ObjectData::rawcode(id).c_str());
+					}
+
+					lua.pop(1);
+				}
+
+				lua.pop(1);
+			}
+
+			lua.pushinteger(edits);
+			return 1;
+		} //l_batch
+
+		static int l_save(Lua::State* L) {
+			Lua lua(L);
+			ObjectData& data = *check(lua, 1);
+			if (!data.save(lua.l_checkstring(2))) {
+				lua.pushnil();
+				lua.pushstring(data.error().c_str());
+				return 2;
+			}
+			lua.pushboolean(true);
+			return 1;
+		} //l_save
+
+	public:
+		static void attach(Lua& lua) {
+			static const Lua::l_Reg methods[] = {
+				{ "get", l_get },
+				{ "set", l_set },
+				{ "unset", l_unset },
+				{ "create", l_create },
+				{ "remove", l_remove },
+				{ "objects", l_objects },
+				{ "batch", l_batch },
+				{ "save", l_save },
+				{ nullptr, nullptr }
+			};
+			static const Lua::l_Reg lib[] = {
+				{ "open", l_open },
+				{ "new", l_new },
+				{ nullptr, nullptr }
+			};
+
+			lua.l_newmetatable("ObjectData");
+			lua.pushcfunction(l_gc);
+			lua.setfield(-2, "__gc");
+			lua.newtable();
+			lua.l_register(nullptr, methods);
+			lua.setfield(-2, "__index");
+			lua.pop(1);
+
+			lua.l_register("objdata", lib);
+			lua.pop(1);
+		} //attach
+}; //ObjectDataLib
@@ -0,0 +1,505 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <stdint.h>
+
+#include "mapped file.hpp"
+#include "trace.hpp"
+
+/*
+*	ObjectData
+*
+*	Reader and writer for Warcraft III object modification files: w3u (units), w3t
+*	(items), w3b (destructables), w3d (doodads), w3a (abilities), w3h (buffs) and w3q
+*	(upgrades). Versions 1 and 2, and the modification sets of version 3, are supported.
+*
+*		int32 version
+*		original table, custom table:
+*			int32 object count
+*			object:
+*				char[4] base id, char[4] new id (0 in the original table)
+*				(version 3) int32 set count, per set int32 flags
+*				int32 modification count
+*				modification:
+*					char[4] field id
+*					int32 type (0 int, 1 real, 2 unreal, 3 string)
+*					(w3d, w3a, w3q) int32 level or variation, int32 data pointer
+*					value (int32, float, float or zero terminated string)
+*					char[4] end token
+*
+*	Opening a file maps it and only indexes where each object starts and ends. The
+*	modifications of an object are parsed the first time it is read or edited. When
+*	saving, tables and objects that were not edited are copied from the mapping as they
+*	are, only edited objects are serialized again.
+*/
+class ObjectData {
+	public:
+		enum Type {
+			INT = 0,
+			REAL = 1,
+			UNREAL = 2,
+			STRING = 3
+		};
+
+		struct Mod {
+			uint32_t field;
+			int32_t type;
+			int32_t level;
+			int32_t pointer;
+			int32_t integer;
+			float real;
+			std::string text;
+			uint32_t end;
+		};
+
+		struct Set {
+			int32_t flags;
+			std::vector<Mod> mods;
+		};
+
+		struct Object {
+			uint32_t base;
+			uint32_t id;
+			const char* start;	//raw bytes in the mapping, nullptr once rewritten
+			const char* end;
+			bool parsed;
+			bool changed;
+			bool removed;
+			std::vector<Set> sets;
+		};
+
+	private:
+		struct Table {
+			const char* start;
+			const char* end;
+			bool changed;
+			std::vector<Object> objects;
+		};
+
+		MappedFile file;
+		int32_t version;
+		bool extended;
+		Table tables[2];
+		std::map<uint32_t, std::pair<int, size_t>> index;
+		std::string failure;
+
+		//bounds checked reads over the mapping
+		class Reader {
+			public:
+				const char* at;
+				const char* end;
+
+				Reader(const char* at, const char* end) : at(at), end(end) { }
+
+				bool u32(uint32_t& value) {
+					if (end - at < 4) {
+						return false;
+					}
+					memcpy(&value, at, 4);
+					at += 4;
+					return true;
+				} //u32
+
+				bool i32(int32_t& value) { return u32(*(uint32_t*)&value); }
+
+				bool f32(float& value) {
+					if (end - at < 4) {
+						return false;
+					}
+					memcpy(&value, at, 4);
+					at += 4;
+					return true;
+				} //f32
+
+				//zero terminated string, text is left empty when only skipping
+				bool str(std::string* text) {
+					const char* zero = (const char*)memchr(at, 0, end - at);
+					if (zero == nullptr) {
+						return false;
+					}
+					if (text != nullptr) {
+						text->assign(at, zero);
+					}
+					at = zero + 1;
+					return true;
+				} //str
+		}; //Reader
+
+		static void put(std::string& out, uint32_t value) { out.append((const char*)&value, 4); }
+
+		//reads the sets of an object, into sets or only past them when sets is nullptr
+		bool readSets(Reader& in, std::vector<Set>* sets) {
+			int32_t count = 1;
+			if (version >= 3 && !in.i32(count)) {
+				return false;
+			}
+
+			for (int32_t i = 0; i < count; ++i) {
+				Set set;
+				set.flags = 0;
+				int32_t mods;
+				if ((version >= 3 && !in.i32(set.flags)) || !in.i32(mods) || mods < 0) {
+					return false;
+				}
+
+				for (int32_t j = 0; j < mods; ++j) {
+					Mod mod;
+					mod.level = 0;
+					mod.pointer = 0;
+					mod.integer = 0;
+					mod.real = 0;
+
+					if (!in.u32(mod.field) || !in.i32(mod.type)) {
+						return false;
+					}
+					if (extended && (!in.i32(mod.level) || !in.i32(mod.pointer))) {
+						return false;
+					}
+
+					bool ok;
+					switch (mod.type) {
+						case INT: ok = in.i32(mod.integer); break;
+						case REAL:
+						case UNREAL: ok = in.f32(mod.real); break;
+						case STRING: ok = in.str(sets != nullptr ? &mod.text : nullptr); break;
+						default: ok = false;
+					}
+					if (!ok || !in.u32(mod.end)) {
+						return false;
+					}
+
+					if (sets != nullptr) {
+						set.mods.push_back(mod);
+					}
+				}
+
+				if (sets != nullptr) {
+					sets->push_back(set);
+				}
+			}
+
+			return true;
+		} //readSets
+
+		bool readTable(Reader& in, Table& table, int which) {
+			table.start = in.at;
+			table.changed = false;
+
+			int32_t count;
+			if (!in.i32(count) || count < 0) {
+				return false;
+			}
+
+			for (int32_t i = 0; i < count; ++i) {
+				Object object;
+				object.start = in.at;
+				object.parsed = false;
+				object.changed = false;
+				object.removed = false;
+
+				if (!in.u32(object.base) || !in.u32(object.id) || !readSets(in, nullptr)) {
+					return false;
+				}
+				object.end = in.at;
+
+				index[which == 0 ? object.base : object.id] = std::make_pair(which, table.objects.size());
+				table.objects.push_back(object);
+			}
+
+			table.end = in.at;
+			return true;
+		} //readTable
+
+		void writeObject(std::string& out, const Object& object) const {
+			if (!object.parsed && object.start != nullptr) {
+				out.append(object.start, object.end);
+				return;
+			}
+
+			put(out, object.base);
+			put(out, object.id);
+			if (version >= 3) {
+				put(out, (uint32_t)object.sets.size());
+			}
+
+			for (auto& set : object.sets) {
+				if (version >= 3) {
+					put(out, (uint32_t)set.flags);
+				}
+				put(out, (uint32_t)set.mods.size());
+
+				for (auto& mod : set.mods) {
+					put(out, mod.field);
+					put(out, (uint32_t)mod.type);
+					if (extended) {
+						put(out, (uint32_t)mod.level);
+						put(out, (uint32_t)mod.pointer);
+					}
+					switch (mod.type) {
+						case INT: put(out, (uint32_t)mod.integer); break;
+						case REAL:
+						case UNREAL: out.append((const char*)&mod.real, 4); break;
+						default: out.append(mod.text.c_str(), mod.text.size() + 1);
+					}
+					put(out, mod.end);
+				}
+			}
+		} //writeObject
+
+		Object* find(uint32_t id) {
+			auto found = index.find(id);
+			if (found == index.end()) {
+				return nullptr;
+			}
+
+			Object& object = tables[found->second.first].objects[found->second.second];
+			return object.removed ? nullptr : &object;
+		} //find
+
+		//parses the modifications of an object on first use
+		Object* parse(uint32_t id) {
+			Object* object = find(id);
+			if (object == nullptr || object->parsed) {
+				return object;
+			}
+
+			if (object->start != nullptr) {
+				Reader in(object->start + 8, object->end);
+				readSets(in, &object->sets);
+			}
+			if (object->sets.empty()) {
+				Set set;
+				set.flags = 0;
+				object->sets.push_back(set);
+			}
+			object->parsed = true;
+
+			return object;
+		} //parse
+
+		void touch(uint32_t id) {
+			auto found = index.find(id);
+			tables[found->second.first].changed = true;
+			tables[found->second.first].objects[found->second.second].changed = true;
+		} //touch
+
+	public:
+		//kind is the file extension, it decides whether modifications carry levels
+		ObjectData(const std::string& kind) : version(2) {
+			extended = kind == "w3d" || kind == "w3a" || kind == "w3q";
+			for (auto& table : tables) {
+				table.start = table.end = nullptr;
+				table.changed = true;
+			}
+		}
+
+		static uint32_t id(const char* rawcode) {
+			uint32_t value = 0;
+			memcpy(&value, rawcode, strlen(rawcode) < 4 ? strlen(rawcode) : 4);
+			return value;
+		} //id
+
+		static std::string rawcode(uint32_t id) { return std::string((const char*)&id, 4); }
+
+		const std::string& error() const { return failure; }
+
+		bool open(const char* filename) {
+			Trace::Scope scope("objdata", "open", filename);
+
+			index.clear();
+			for (auto& table : tables) {
+				table.objects.clear();
+			}
+
+			if (!file.open(filename)) {
+				failure = std::string("cannot open ") + filename;
+				return false;
+			}
+
+			Reader in(file.data(), file.data() + file.size());
+			if (!in.i32(version) || version < 1 || version > 3) {
+				failure = std::string("unsupported object data version in ") + filename;
+				return false;
+			}
+			if (!readTable(in, tables[0], 0) || !readTable(in, tables[1], 1)) {
+				failure = std::string("malformed object data in ") + filename;
+				return false;
+			}
+
+			return true;
+		} //open
+
+		//ids of the objects in a table, 0 original, 1 custom
+		std::vector<uint32_t> objects(int table) const {
+			std::vector<uint32_t> ids;
+			for (auto& object : tables[table].objects) {
+				if (!object.removed) {
+					ids.push_back(table == 0 ? object.base : object.id);
+				}
+			}
+			return ids;
+		} //objects
+
+		//returns the modification of field at level, or nullptr
+		const Mod* get(uint32_t id, uint32_t field, int32_t level = 0) {
+			Object* object = parse(id);
+			if (object == nullptr) {
+				return nullptr;
+			}
+
+			for (auto& set : object->sets) {
+				for (auto& mod : set.mods) {
+					if (mod.field == field && mod.level == level) {
+						return &mod;
+					}
+				}
+			}
+			return nullptr;
+		} //get
+
+		//sets field at level in the first set of the object, creating the modification as needed
+		//pointer is only used for a new modification; returns false if the object does not exist
+		bool set(uint32_t id, uint32_t field, int32_t level, int32_t type, int32_t integer, float real, const std::string& text, int32_t pointer = 0) {
+			Object* object = parse(id);
+			if (object == nullptr) {
+				return false;
+			}
+
+			Mod* target = nullptr;
+			for (auto& set : object->sets) {
+				for (auto& mod : set.mods) {
+					if (mod.field == field && mod.level == level) {
+						target = &mod;
+					}
+				}
+			}
+
+			if (target == nullptr) {
+				Mod mod;
+				mod.field = field;
+				mod.level = level;
+				mod.pointer = pointer;
+				mod.end = object->id != 0 ? object->id : object->base;
+				object->sets[0].mods.push_back(mod);
+				target = &object->sets[0].mods.back();
+			}
+
+			target->type = type;
+			target->integer = integer;
+			target->real = real;
+			target->text = text;
+
+			touch(id);
+			return true;
+		} //set
+
+		//removes a modification, returns false if there was none
+		bool unset(uint32_t id, uint32_t field, int32_t level = 0) {
+			Object* object = parse(id);
+			if (object == nullptr) {
+				return false;
+			}
+
+			for (auto& set : object->sets) {
+				for (size_t i = 0; i < set.mods.size(); ++i) {
+					if (set.mods[i].field == field && set.mods[i].level == level) {
+						set.mods.erase(set.mods.begin() + i);
+						touch(id);
+						return true;
+					}
+				}
+			}
+			return false;
+		} //unset
+
+		//adds a custom object based on base, returns false if id is taken
+		bool create(uint32_t id, uint32_t base) {
+			if (find(id) != nullptr) {
+				return false;
+			}
+
+			Object object;
+			object.base = base;
+			object.id = id;
+			object.start = object.end = nullptr;
+			object.parsed = true;
+			object.changed = true;
+			object.removed = false;
+			object.sets.push_back(Set());
+			object.sets.back().flags = 0;
+
+			index[id] = std::make_pair(1, tables[1].objects.size());
+			tables[1].objects.push_back(object);
+			tables[1].changed = true;
+			return true;
+		} //create
+
+		//removes an object and its modifications
+		bool remove(uint32_t id) {
+			Object* object = find(id);
+			if (object == nullptr) {
+				return false;
+			}
+
+			object->removed = true;
+			touch(id);
+			index.erase(id);
+			return true;
+		} //remove
+
+		//serializes the file, copying unedited tables and objects as they are
+		void serialize(std::string& out) const {
+			put(out, (uint32_t)version);
+
+			for (auto& table : tables) {
+				if (!table.changed && table.start != nullptr) {
+					out.append(table.start, table.end);
+					continue;
+				}
+
+				uint32_t count = 0;
+				for (auto& object : table.objects) {
+					count += object.removed ? 0 : 1;
+				}
+				put(out, count);
+
+				for (auto& object : table.objects) {
+					if (!object.removed) {
+						writeObject(out, object);
+					}
+				}
+			}
+		} //serialize
+
+		bool save(const char* filename) {
+			Trace::Scope scope("objdata", "save", filename);
+
+			std::string out;
+			serialize(out);
+
+			//the mapping may be the file being replaced, let go of it first
+			for (auto& table : tables) {
+				for (auto& object : table.objects) {
+					if (!object.removed) {
+						parse(&table == &tables[1] ? object.id : object.base);
+					}
+					object.start = object.end = nullptr;
+				}
+				table.start = table.end = nullptr;
+				table.changed = true;
+			}
+			file.close();
+
+			std::ofstream stream(filename, std::ios::binary);
+			if (!stream.is_open()) {
+				failure = std::string("cannot write ") + filename;
+				return false;
+			}
+			stream.write(out.data(), out.size());
+			return !stream.fail();
+		} //save
+}; //ObjectData
@@ -0,0 +1,339 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <sstream>
+
+#include "luacpp.hpp"
+#include "json.hpp"
+
+/*
+*	PhaseLog
+*
+*	Records wall time, Lua heap size, completed GC cycles and allocator activity for
+*	named build phases, and applies a GC policy while a phase runs.
+*
+*	Lua API (library "phase")
+*
+*		phase.begin(name [, policy])	starts a phase, phases nest
+*		phase.finish()					ends the innermost phase
+*		phase.policy(name, policy)		sets the default policy for phases called name
+*		phase.json()					returns the recorded phases as JSON
+*
+*	A policy is a table with any of
+*
+*		stop = true			stop the collector for the phase (LUA_GCSTOP)
+*		pause = n			LUA_GCSETPAUSE for the phase
+*		stepmul = n			LUA_GCSETSTEPMUL for the phase
+*		collect = true		full collection when the phase finishes
+*
+*	for example stopping the collector while tokenizing and collecting afterwards
+*
+*		phase.begin("tokenize", { stop = true, collect = true })
+*
+*	The log wraps the allocator of the state it is attached to and must outlive it.
+*/
+class PhaseLog {
+	public:
+		struct Policy {
+			bool stop;
+			bool collect;
+			int pause;
+			int stepmul;
+
+			Policy() : stop(false), collect(false), pause(-1), stepmul(-1) { }
+		};
+
+		struct Record {
+			std::string name;
+			size_t depth;
+			double start;		//ms since the log was created
+			double wall;		//ms
+			size_t heapStart;	//bytes
+			size_t heapEnd;		//bytes
+			size_t cycles;
+			size_t allocs;
+			size_t frees;
+			size_t allocated;	//bytes requested
+		};
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		struct Open {
+			size_t record;
+			Clock::time_point start;
+			size_t cycles;
+			size_t allocs;
+			size_t frees;
+			size_t allocated;
+			Policy policy;
+			int pause;
+			int stepmul;
+			bool stopped;	//collector already stopped by an enclosing phase
+		};
+
+		Clock::time_point created;
+		std::vector<Record> records;
+		std::vector<Open> open;
+		std::vector<std::pair<std::string, Policy>> policies;
+
+		//allocator wrapper
+		Lua::Alloc allocf;
+		void* allocud;
+		size_t allocs;
+		size_t frees;
+		size_t allocated;
+
+		size_t cycles;
+
+		static void* alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+			PhaseLog& log = *(PhaseLog*)ud;
+
+			if (nsize == 0) {
+				if (ptr != nullptr) {
+					++log.frees;
+				}
+			} else if (ptr == nullptr) {
+				++log.allocs;
+				log.allocated += nsize;
+			} else if (nsize > osize) {
+				log.allocated += nsize - osize;
+			}
+
+			return log.allocf(log.allocud, ptr, osize, nsize);
+		} //alloc
+
+		static size_t heap(Lua& lua) {
+			return (size_t)lua.gc(LUA_GCCOUNT, 0) * 1024 + (size_t)lua.gc(LUA_GCCOUNTB, 0);
+		} //heap
+
+		static PhaseLog& get(Lua& lua) {
+			lua.getfield(LUA_REGISTRYINDEX, "PhaseLog");
+			PhaseLog* log = (PhaseLog*)lua.touserdata(-1);
+			lua.pop(1);
+			return *log;
+		} //get
+
+		//creates an unreferenced userdata whose finalizer counts a GC cycle and makes the next one
+		static void sentinel(Lua& lua) {
+			lua.newuserdata(1);
+			lua.l_getmetatable("PhaseLog.sentinel");
+			lua.setmetatable(-2);
+			lua.pop(1);
+		} //sentinel
+
+		static int onCollect(Lua::State* L) {
+			Lua lua(L);
+			++get(lua).cycles;
+			sentinel(lua);
+			return 0;
+		} //onCollect
+
+		static Policy readPolicy(Lua& lua, int index) {
+			Policy policy;
+
+			if (lua.istable(index)) {
+				lua.getfield(index, "stop");
+				policy.stop = lua.toboolean(-1) != 0;
+				lua.getfield(index, "collect");
+				policy.collect = lua.toboolean(-1) != 0;
+				lua.getfield(index, "pause");
+				policy.pause = lua.isnumber(-1) ? (int)lua.tointeger(-1) : -1;
+				lua.getfield(index, "stepmul");
+				policy.stepmul = lua.isnumber(-1) ? (int)lua.tointeger(-1) : -1;
+				lua.pop(4);
+			}
+
+			return policy;
+		} //readPolicy
+
+		static int l_begin(Lua::State* L) {
+			Lua lua(L);
+			PhaseLog& log = get(lua);
+			std::string name = lua.l_checkstring(1);
+
+			if (lua.istable(2)) {
+				log.begin(lua, name, readPolicy(lua, 2));
+			} else {
+				log.begin(lua, name);
+			}
+
+			return 0;
+		} //l_begin
+
+		static int l_finish(Lua::State* L) {
+			Lua lua(L);
+			get(lua).finish(lua);
+			return 0;
+		} //l_finish
+
+		static int l_policy(Lua::State* L) {
+			Lua lua(L);
+			get(lua).policy(lua.l_checkstring(1), readPolicy(lua, 2));
+			return 0;
+		} //l_policy
+
+		static int l_json(Lua::State* L) {
+			Lua lua(L);
+			std::ostringstream out;
+			get(lua).json(out);
+			std::string json = out.str();
+			lua.pushlstring(json.data(), json.size());
+			return 1;
+		} //l_json
+
+	public:
+		PhaseLog() : created(Clock::now()), allocf(nullptr), allocud(nullptr), allocs(0), frees(0), allocated(0), cycles(0) { }
+
+		//installs the allocator wrapper, the GC cycle counter and the phase library
+		void attach(Lua& lua) {
+			allocf = lua.getallocf(&allocud);
+			lua.setallocf(alloc, this);
+
+			lua.pushlightuserdata(this);
+			lua.setfield(LUA_REGISTRYINDEX, "PhaseLog");
+
+			lua.l_newmetatable("PhaseLog.sentinel");
+			lua.pushcfunction(onCollect);
+			lua.setfield(-2, "__gc");
+			lua.pop(1);
+			sentinel(lua);
+
+			static const Lua::l_Reg lib[] = {
+				{ "begin", l_begin },
+				{ "finish", l_finish },
+				{ "policy", l_policy },
+				{ "json", l_json },
+				{ nullptr, nullptr }
+			};
+			lua.l_register("phase", lib);
+			lua.pop(1);
+		} //attach
+
+		//sets the policy used by phases named name that do not pass their own
+		void policy(const std::string& name, const Policy& policy) {
+			for (auto& entry : policies) {
+				if (entry.first == name) {
+					entry.second = policy;
+					return;
+				}
+			}
+			policies.push_back(std::make_pair(name, policy));
+		} //policy
+
+		void begin(Lua& lua, const std::string& name) {
+			for (auto& entry : policies) {
+				if (entry.first == name) {
+					begin(lua, name, entry.second);
+					return;
+				}
+			}
+			begin(lua, name, Policy());
+		} //begin
+
+		void begin(Lua& lua, const std::string& name, const Policy& policy) {
+			Record record;
+			record.name = name;
+			record.depth = open.size();
+			record.heapStart = heap(lua);
+			records.push_back(record);
+
+			Open phase;
+			phase.record = records.size() - 1;
+			phase.policy = policy;
+			phase.pause = policy.pause != -1 ? lua.gc(LUA_GCSETPAUSE, policy.pause) : -1;
+			phase.stepmul = policy.stepmul != -1 ? lua.gc(LUA_GCSETSTEPMUL, policy.stepmul) : -1;
+			phase.stopped = !open.empty() && (open.back().stopped || open.back().policy.stop);
+			if (policy.stop && !phase.stopped) {
+				lua.gc(LUA_GCSTOP, 0);
+			}
+			phase.cycles = cycles;
+			phase.allocs = allocs;
+			phase.frees = frees;
+			phase.allocated = allocated;
+			phase.start = Clock::now();
+			open.push_back(phase);
+		} //begin
+
+		void finish(Lua& lua) {
+			if (open.empty()) {
+				return;
+			}
+			Open& phase = open.back();
+
+			if (phase.policy.stop && !phase.stopped) {
+				lua.gc(LUA_GCRESTART, 0);
+			}
+			if (phase.pause != -1) {
+				lua.gc(LUA_GCSETPAUSE, phase.pause);
+			}
+			if (phase.stepmul != -1) {
+				lua.gc(LUA_GCSETSTEPMUL, phase.stepmul);
+			}
+			if (phase.policy.collect) {
+				lua.gc(LUA_GCCOLLECT, 0);
+				//a full collection starts the collector again
+				if (phase.stopped) {
+					lua.gc(LUA_GCSTOP, 0);
+				}
+			}
+
+			Clock::time_point end = Clock::now();
+			Record& record = records[phase.record];
+			record.start = std::chrono::duration<double, std::milli>(phase.start - created).count();
+			record.wall = std::chrono::duration<double, std::milli>(end - phase.start).count();
+			record.heapEnd = heap(lua);
+			record.cycles = cycles - phase.cycles;
+			record.allocs = allocs - phase.allocs;
+			record.frees = frees - phase.frees;
+			record.allocated = allocated - phase.allocated;
+
+			open.pop_back();
+		} //finish
+
+		//finishes every open phase
+		void finishAll(Lua& lua) {
+			while (!open.empty()) {
+				finish(lua);
+			}
+		} //finishAll
+
+		const std::vector<Record>& phases() const { return records; }
+
+		void json(std::ostream& out) const {
+			//phases still open have no end values yet
+			std::vector<size_t> finished;
+			for (size_t i = 0; i < records.size(); ++i) {
+				bool done = true;
+				for (auto& phase : open) {
+					done = done && phase.record != i;
+				}
+				if (done) {
+					finished.push_back(i);
+				}
+			}
+
+			out << "[";
+			for (size_t i = 0; i < finished.size(); ++i) {
+				const Record& record = records[finished[i]];
+
+				out << (i ? ",\n\t{" : "\n\t{");
+				out << "\"name\": ";
+				Json::string(out, record.name);
+				out << ", \"depth\": " << record.depth;
+				out << ", \"start_ms\": " << record.start;
+				out << ", \"wall_ms\": " << record.wall;
+				out << ", \"heap_start\": " << record.heapStart;
+				out << ", \"heap_end\": " << record.heapEnd;
+				out << ", \"gc_cycles\": " << record.cycles;
+				out << ", \"allocs\": " << record.allocs;
+				out << ", \"frees\": " << record.frees;
+				out << ", \"allocated\": " << record.allocated;
+				out << "}";
+			}
+			out << "\n]\n";
+		} //json
+}; //PhaseLog
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <cerrno>
+#include <mutex>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+#include "trace.hpp"
+
+/*
+*	Process
+*
+*	Runs a shell command (cmd /c on Windows, sh -c elsewhere, like os.execute) and
+*	captures its standard output and error. Each pipe is drained by its own thread so a
+*	child filling one of them never blocks.
+*
+*	Pipes are created and handed to the child under a lock, so that a child started
+*	concurrently cannot inherit the write end of another job's pipe and hold it open.
+*/
+namespace Process {
+	struct Result {
+		bool started;
+		int code;
+		std::string out;
+		std::string err;
+	};
+
+#ifdef _WIN32
+	inline void drain(HANDLE pipe, std::string& into) {
+		char buffer[4096];
+		DWORD read;
+		while (ReadFile(pipe, buffer, sizeof(buffer), &read, nullptr) && read > 0) {
+			into.append(buffer, read);
+		}
+		CloseHandle(pipe);
+	} //drain
+#else
+	inline void drain(int pipe, std::string& into) {
+		char buffer[4096];
+		ssize_t count;
+		while ((count = read(pipe, buffer, sizeof(buffer))) != 0) {
+			if (count < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				break;
+			}
+			into.append(buffer, (size_t)count);
+		}
+		close(pipe);
+	} //drain
+#endif
+
+	inline std::mutex& spawnLock() {
+		static std::mutex lock;
+		return lock;
+	} //spawnLock
+
+	inline Result run(const std::string& command) {
+		Trace::Scope scope("process", "run", command.c_str());
+		Result result = { false, -1, std::string(), std::string() };
+		std::unique_lock<std::mutex> spawning(spawnLock());
+
+#ifdef _WIN32
+		SECURITY_ATTRIBUTES security = { sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+		HANDLE outRead, outWrite, errRead, errWrite;
+		if (!CreatePipe(&outRead, &outWrite, &security, 0)) {
+			return result;
+		}
+		if (!CreatePipe(&errRead, &errWrite, &security, 0)) {
+			CloseHandle(outRead);
+			CloseHandle(outWrite);
+			return result;
+		}
+		SetHandleInformation(outRead, HANDLE_FLAG_INHERIT, 0);
+		SetHandleInformation(errRead, HANDLE_FLAG_INHERIT, 0);
+
+		STARTUPINFOA startup;
+		ZeroMemory(&startup, sizeof(startup));
+		startup.cb = sizeof(startup);
+		startup.dwFlags = STARTF_USESTDHANDLES;
+		startup.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+		startup.hStdOutput = outWrite;
+		startup.hStdError = errWrite;
+
+		PROCESS_INFORMATION process;
+		std::string line = "cmd.exe /c " + command;
+		BOOL created = CreateProcessA(nullptr, &line[0], nullptr, nullptr, TRUE, CREATE_NO_WINDOW, nullptr, nullptr, &startup, &process);
+		CloseHandle(outWrite);
+		CloseHandle(errWrite);
+		spawning.unlock();
+
+		if (!created) {
+			CloseHandle(outRead);
+			CloseHandle(errRead);
+			return result;
+		}
+		result.started = true;
+
+		std::thread err([&] { drain(errRead, result.err); });
+		drain(outRead, result.out);
+		err.join();
+
+		WaitForSingleObject(process.hProcess, INFINITE);
+		DWORD code = 0;
+		GetExitCodeProcess(process.hProcess, &code);
+		result.code = (int)code;
+		CloseHandle(process.hProcess);
+		CloseHandle(process.hThread);
+#else
+		int out[2];
+		int err[2];
+		if (pipe(out) != 0) {
+			return result;
+		}
+		if (pipe(err) != 0) {
+			close(out[0]);
+			close(out[1]);
+			return result;
+		}
+
+		posix_spawn_file_actions_t actions;
+		posix_spawn_file_actions_init(&actions);
+		posix_spawn_file_actions_adddup2(&actions, out[1], 1);
+		posix_spawn_file_actions_adddup2(&actions, err[1], 2);
+		posix_spawn_file_actions_addclose(&actions, out[0]);
+		posix_spawn_file_actions_addclose(&actions, err[0]);
+
+		const char* argv[] = { "sh", "-c", command.c_str(), nullptr };
+		pid_t pid;
+		int spawned = posix_spawn(&pid, "/bin/sh", &actions, nullptr, (char* const*)argv, environ);
+		posix_spawn_file_actions_destroy(&actions);
+		close(out[1]);
+		close(err[1]);
+		spawning.unlock();
+
+		if (spawned != 0) {
+			close(out[0]);
+			close(err[0]);
+			return result;
+		}
+		result.started = true;
+
+		std::thread reader([&] { drain(err[0], result.err); });
+		drain(out[0], result.out);
+		reader.join();
+
+		int status = 0;
+		while (waitpid(pid, &status, 0) == -1 && errno == EINTR) { }
+		result.code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+
+		return result;
+	} //run
+} //Process
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "luacpp.hpp"
+#include "content store.hpp"
+
+/*
+*	Lua access to ContentStore (library "store")
+*
+*		store.load(path)			content, key of a file, nil if it cannot be read
+*		store.get(key)				stored content or nil
+*		store.put(value [, key])	stores value, returns its key
+*		store.key(step, ...)		key for step applied to the given keys or strings (not tables)
+*		store.cached(key, fn)		stored content, or the string returned by fn() after storing it
+*		store.stats()				hits, misses, bytes held
+*
+*	The store is shared by every state of the process, so a batch reads and processes a
+*	common library once, for example
+*
+*		local source, key = store.load("libs/core.j")
+*		local expanded = store.cached(store.key("expand", key, "DEBUG=" .. tostring(DEBUG)), function()
+*			return expand(source, { DEBUG = DEBUG })
+*		end)
+*/
+class StoreLib {
+	private:
+		static void push(Lua& lua, const ContentStore::Buffer& buffer) {
+			if (buffer) {
+				lua.pushlstring(buffer->data(), buffer->size());
+			} else {
+				lua.pushnil();
+			}
+		} //push
+
+		static int l_load(Lua::State* L) {
+			Lua lua(L);
+			ContentStore::Buffer buffer;
+			std::string key = ContentStore::shared().load(lua.l_checkstring(1), &buffer);
+			if (key.empty()) {
+				lua.pushnil();
+				return 1;
+			}
+
+			push(lua, buffer);
+			lua.pushlstring(key.data(), key.size());
+			return 2;
+		} //l_load
+
+		static int l_get(Lua::State* L) {
+			Lua lua(L);
+			push(lua, ContentStore::shared().get(lua.l_checkstring(1)));
+			return 1;
+		} //l_get
+
+		static int l_put(Lua::State* L) {
+			Lua lua(L);
+			size_t size;
+			const char* value = lua.l_checklstring(1, &size);
+			std::string key = ContentStore::shared().put(std::string(value, size), lua.isstring(2) ? lua.tostring(2) : "");
+			lua.pushlstring(key.data(), key.size());
+			return 1;
+		} //l_put
+
+		static int l_key(Lua::State* L) {
+			Lua lua(L);
+			std::string step = lua.l_checkstring(1);
+			std::vector<std::string> inputs;
+			for (int i = 2; i <= lua.gettop(); ++i) {
+				size_t size;
+				const char* input = lua.l_checklstring(i, &size);
+				inputs.push_back(std::string(input, size));
+			}
+			std::string key = ContentStore::derive(inputs, step);
+			lua.pushlstring(key.data(), key.size());
+			return 1;
+		} //l_key
+
+		static int l_cached(Lua::State* L) {
+			Lua lua(L);
+			std::string key = lua.l_checkstring(1);
+			lua.l_checktype(2, LUA_TFUNCTION);
+
+			ContentStore::Buffer buffer = ContentStore::shared().get(key);
+			if (buffer) {
+				push(lua, buffer);
+				return 1;
+			}
+
+			lua.pushvalue(2);
+			lua.call(0, 1);
+			size_t size;
+			const char* value = lua.tolstring(-1, &size);
+			if (value == nullptr) {
+				return lua.l_error("store.cached: function must return a string");
+			}
+			ContentStore::shared().put(std::string(value, size), key);
+			return 1;
+		} //l_cached
+
+		static int l_stats(Lua::State* L) {
+			Lua lua(L);
+			size_t hits, misses;
+			ContentStore::shared().stats(hits, misses);
+			lua.pushnumber((Lua::Number)hits);
+			lua.pushnumber((Lua::Number)misses);
+			lua.pushnumber((Lua::Number)ContentStore::shared().size());
+			return 3;
+		} //l_stats
+
+	public:
+		static void attach(Lua& lua) {
+			static const Lua::l_Reg lib[] = {
+				{ "load", l_load },
+				{ "get", l_get },
+				{ "put", l_put },
+				{ "key", l_key },
+				{ "cached", l_cached },
+				{ "stats", l_stats },
+				{ nullptr, nullptr }
+			};
+			lua.l_register("store", lib);
+			lua.pop(1);
+		} //attach
+}; //StoreLib
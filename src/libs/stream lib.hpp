@@ -0,0 +1,101 @@
+#pragma once
+
+#include <fstream>
+
+#include "luacpp.hpp"
+#include "stream.hpp"
+
+/*
+*	Lua access to Stream (library "stream")
+*
+*		stream.process{
+*			input = "war3map.j",		file read in chunks
+*			output = "out.j",			file written as lines are emitted
+*			strip = true,				remove comments, whitespace and blank lines
+*			defines = { DEBUG = "false" },	identifiers to replace
+*			chunk = 1048576,			chunk size in bytes
+*			chunks = 4,					chunks alive at once
+*			windows = 4,				windows queued between stages
+*		}
+*
+*	returns bytes read and written, or nil and a message
+*/
+class StreamLib {
+	private:
+		//optional positive integer field of the options table
+		static size_t positive(Lua& lua, const char* field, size_t fallback) {
+			lua.getfield(1, field);
+			Lua::Integer value = lua.l_optinteger(-1, (Lua::Integer)fallback);
+			lua.pop(1);
+			if (value < 1) {
+				lua.l_argerror(1, lua.pushfstring("%s must be positive", field));
+			}
+			return (size_t)value;
+		} //positive
+
+		static int l_process(Lua::State* L) {
+			Lua lua(L);
+			lua.l_checktype(1, LUA_TTABLE);
+
+			Stream::Options options;
+
+			lua.getfield(1, "input");
+			std::string input = lua.l_checkstring(-1);
+			lua.getfield(1, "output");
+			std::string output = lua.l_checkstring(-1);
+			lua.getfield(1, "strip");
+			options.strip = lua.isnil(-1) || lua.toboolean(-1);
+			lua.pop(3);
+			options.chunkSize = positive(lua, "chunk", options.chunkSize);
+			options.chunks = positive(lua, "chunks", options.chunks);
+			options.windows = positive(lua, "windows", options.windows);
+
+			lua.getfield(1, "defines");
+			if (lua.istable(-1)) {
+				lua.pushnil();
+				while (lua.next(-2)) {
+					if (lua.type(-2) == LUA_TSTRING && lua.isstring(-1)) {
+						options.defines[lua.tostring(-2)] = lua.tostring(-1);
+					}
+					lua.pop(1);
+				}
+			}
+			lua.pop(1);
+
+			//the input is opened first, so a missing input leaves an earlier output in place
+			std::ifstream in(input.c_str(), std::ios::binary);
+			if (!in.is_open()) {
+				lua.pushnil();
+				lua.pushstring(("cannot open " + input).c_str());
+				return 2;
+			}
+
+			std::ofstream out(output.c_str(), std::ios::binary);
+			if (!out.is_open()) {
+				lua.pushnil();
+				lua.pushstring(("cannot open " + output).c_str());
+				return 2;
+			}
+
+			Stream::Result result = Stream::process(in, input.c_str(), out, options);
+			if (!result.ok) {
+				lua.pushnil();
+				lua.pushstring(("cannot stream " + input + " to " + output).c_str());
+				return 2;
+			}
+
+			lua.pushnumber((Lua::Number)result.read);
+			lua.pushnumber((Lua::Number)result.written);
+			return 2;
+		} //l_process
+
+	public:
+		static void attach(Lua& lua) {
+			static const Lua::l_Reg lib[] = {
+				{ "process", l_process },
+				{ nullptr, nullptr }
+			};
+			lua.l_register("stream", lib);
+			lua.pop(1);
+		} //attach
+}; //StreamLib
@@ -0,0 +1,487 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <fstream>
+#include <ostream>
+#include <stdint.h>
+
+#include "bounded queue.hpp"
+#include "trace.hpp"
+
+/*
+*	Stream
+*
+*	Processes a script in fixed size chunks instead of reading it whole, so memory use
+*	stays flat however large the input is.
+*
+*		reader -> tokenize -> [strip] -> [expand] -> emit
+*
+*	The reader fills chunks from a fixed pool. Tokenize splits them into windows of line
+*	spans that point into the chunks, and every stage runs on its own thread, passing
+*	windows through bounded queues. A chunk goes back to the pool once every window
+*	referencing it has been emitted; the reader waits for a free chunk and a full queue
+*	stalls the stage feeding it, so at most chunks * chunkSize bytes of input are alive.
+*
+*	Stages work on spans in place and never copy the text of a line. A line longer than
+*	a chunk reaches the stages in several pieces, only the last one has eol set.
+*/
+namespace Stream {
+	//[start, end) of a piece of a line, eol is set on the last piece of each line
+	struct Span {
+		const char* start;
+		const char* end;
+		bool eol;
+	};
+
+	class Chunk {
+		private:
+			std::atomic<int> refs;
+			BoundedQueue<Chunk*>* pool;
+
+		public:
+			char* data;
+			size_t size;
+
+			//pool is where the chunk returns once released, nullptr for a one off chunk
+			Chunk(size_t capacity, BoundedQueue<Chunk*>* pool) : refs(0), pool(pool), size(0) {
+				data = new char[capacity];
+			}
+
+			~Chunk() { delete [] data; }
+
+			void retain() { ++refs; }
+
+			void release() {
+				if (--refs == 0) {
+					if (pool != nullptr) {
+						size = 0;
+						pool->push(this);
+					} else {
+						delete this;
+					}
+				}
+			} //release
+	}; //Chunk
+
+	//a bounded batch of spans and the chunks they point into
+	struct Window {
+		std::vector<Span> spans;
+		std::vector<Chunk*> chunks;
+
+		void hold(Chunk* chunk) {
+			chunk->retain();
+			chunks.push_back(chunk);
+		} //hold
+
+		~Window() {
+			for (auto chunk : chunks) {
+				chunk->release();
+			}
+		}
+	}; //Window
+
+	class Stage {
+		public:
+			virtual ~Stage() { }
+
+			//rewrites the spans of a window in place
+			virtual void process(Window& window) = 0;
+	}; //Stage
+
+	/*
+	*	Strip
+	*
+	*	Removes line and block comments, leading and trailing whitespace and blank lines.
+	*	//! directive lines are kept. Only narrows or drops spans.
+	*
+	*	A line may arrive in several pieces, so comment and string state carries over from
+	*	one span to the next until the span that ends the line.
+	*/
+	class Strip : public Stage {
+		private:
+			bool block;		//inside a block comment
+			bool comment;	//rest of the line is a line comment
+			bool keep;		//the line is a //! directive
+			char quote;		//inside a string or rawcode
+			bool midline;	//the last span did not end its line
+			bool pending;	//the line has output, it still needs its eol
+			bool trim;		//at the start of the line or after a comment, whitespace is dropped
+			bool gap;		//after a block comment, the next output is a separate token
+
+			static bool space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+			void line(const Span& span, std::vector<Span>& out) {
+				size_t first = out.size();
+				bool start = !midline;
+				midline = !span.eol;
+
+				if (start) {
+					keep = !block && directive(span.start, span.end);
+					trim = true;
+					gap = false;
+				}
+
+				if (keep) {
+					add(span.start, span.end, span.eol, out);
+				} else if (!comment) {
+					const char* piece = span.start;
+
+					for (const char* c = span.start; c < span.end; ++c) {
+						if (block) {
+							if (*c == '*' && c + 1 < span.end && c[1] == '/') {
+								block = false;
+								piece = ++c + 1;
+								trim = true;
+								gap = true;
+							}
+							continue;
+						}
+
+						if (quote != 0) {
+							if (*c == '\\') {
+								++c;
+							} else if (*c == quote) {
+								quote = 0;
+							}
+						} else if (*c == '"' || *c == '\'') {
+							quote = *c;
+						} else if (*c == '/' && c + 1 < span.end && c[1] == '/') {
+							add(piece, c, true, out);
+							comment = true;
+							break;
+						} else if (*c == '/' && c + 1 < span.end && c[1] == '*') {
+							add(piece, c, true, out);
+							block = true;
+							++c;
+						}
+					}
+
+					if (!block && !comment) {
+						add(piece, span.end, span.eol, out);
+					}
+				}
+
+				if (span.eol) {
+					if (pending) {
+						if (out.size() > first) {
+							out.back().eol = true;
+						} else {
+							//the output of the line went out with an earlier span
+							static const char* none = "";
+							out.push_back(Span{ none, none, true });
+						}
+					}
+					comment = false;
+					quote = 0;
+					pending = false;
+				}
+			} //line
+
+			//true if the line is a //! directive
+			static bool directive(const char* start, const char* end) {
+				while (start < end && space(*start)) {
+					++start;
+				}
+				return end - start >= 3 && start[0] == '/' && start[1] == '/' && start[2] == '!';
+			} //directive
+
+			//trailing whitespace of a piece that does not end the line becomes a gap, unless it is inside a string
+			void add(const char* start, const char* end, bool trimEnd, std::vector<Span>& out) {
+				while (trim && start < end && space(*start)) {
+					++start;
+				}
+				const char* text = end;
+				while ((trimEnd || quote == 0) && text > start && space(text[-1])) {
+					--text;
+				}
+				bool spaced = !trimEnd && text < end;
+				end = text;
+				if (start < end) {
+					//pieces around a block comment stay separate tokens
+					if (gap && pending) {
+						static const char* space = " ";
+						out.push_back(Span{ space, space + 1, false });
+					}
+					out.push_back(Span{ start, end, false });
+					pending = true;
+					trim = false;
+					gap = false;
+				}
+				gap = gap || spaced;
+			} //add
+
+		public:
+			Strip() : block(false), comment(false), keep(false), quote(0), midline(false), pending(false), trim(true), gap(false) { }
+
+			void process(Window& window) {
+				std::vector<Span> out;
+				out.reserve(window.spans.size());
+
+				for (auto& span : window.spans) {
+					line(span, out);
+				}
+
+				window.spans.swap(out);
+			} //process
+	}; //Strip
+
+	/*
+	*	Expand
+	*
+	*	Replaces whole identifiers found in a define table with their values. Values are
+	*	owned by the stage, so replaced pieces point at them instead of the input.
+	*/
+	class Expand : public Stage {
+		private:
+			std::map<std::string, std::string> defines;
+			bool quoted;	//the last span ended inside a string that goes on in the next piece of the line
+
+			static bool word(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'; }
+
+		public:
+			Expand(const std::map<std::string, std::string>& defines) : defines(defines), quoted(false) { }
+
+			void process(Window& window) {
+				if (defines.empty()) {
+					return;
+				}
+
+				std::vector<Span> out;
+				out.reserve(window.spans.size());
+				std::string name;
+
+				for (auto& span : window.spans) {
+					size_t first = out.size();
+					const char* piece = span.start;
+					const char* c = span.start;
+					bool inside = quoted;
+
+					while (c < span.end) {
+						if (inside || *c == '"') {
+							if (!inside) {
+								++c;
+								inside = true;
+							}
+							for (; c < span.end && *c != '"'; ++c) {
+								if (*c == '\\') {
+									++c;
+								}
+							}
+							if (c < span.end) {
+								inside = false;
+								++c;
+							}
+							continue;
+						}
+						if (!word(*c)) {
+							++c;
+							continue;
+						}
+
+						const char* start = c;
+						while (c < span.end && word(*c)) {
+							++c;
+						}
+						name.assign(start, c);
+
+						auto define = defines.find(name);
+						if (define != defines.end()) {
+							if (piece < start) {
+								out.push_back(Span{ piece, start, false });
+							}
+							out.push_back(Span{ define->second.data(), define->second.data() + define->second.size(), false });
+							piece = c;
+						}
+					}
+
+					if (piece < span.end || out.size() == first) {
+						out.push_back(Span{ piece, span.end, false });
+					}
+					out.back().eol = span.eol;
+					quoted = inside && !span.eol;
+				}
+
+				window.spans.swap(out);
+			} //process
+	}; //Expand
+
+	struct Options {
+		size_t chunkSize;
+		size_t chunks;		//chunk pool size
+		size_t windows;		//queue depth between stages
+		bool strip;
+		std::map<std::string, std::string> defines;
+
+		Options() : chunkSize(1 << 20), chunks(4), windows(4), strip(true) { }
+	};
+
+	struct Result {
+		bool ok;
+		uint64_t read;
+		uint64_t written;
+	};
+
+	//streams file, named input, through the configured stages into out
+	inline Result process(std::istream& file, const char* input, std::ostream& out, const Options& options) {
+		Trace::Scope scope("stream", "process", input);
+		Result result = { false, 0, 0 };
+
+		size_t chunkSize = options.chunkSize < 64 ? 64 : options.chunkSize;
+		size_t chunkCount = options.chunks < 2 ? 2 : options.chunks;
+
+		BoundedQueue<Chunk*> pool(chunkCount);
+		std::vector<Chunk*> chunks;
+		for (size_t i = 0; i < chunkCount; ++i) {
+			chunks.push_back(new Chunk(chunkSize, &pool));
+			pool.push(chunks.back());
+		}
+
+		std::vector<Stage*> stages;
+		if (options.strip) {
+			stages.push_back(new Strip());
+		}
+		if (!options.defines.empty()) {
+			stages.push_back(new Expand(options.defines));
+		}
+
+		BoundedQueue<Chunk*> filled(chunkCount);
+		std::vector<BoundedQueue<Window*>*> queues;
+		for (size_t i = 0; i <= stages.size(); ++i) {
+			queues.push_back(new BoundedQueue<Window*>(options.windows));
+		}
+
+		std::vector<std::thread> threads;
+
+		//reader
+		threads.push_back(std::thread([&] {
+			Chunk* chunk;
+			while (pool.pop(chunk)) {
+				file.read(chunk->data, chunkSize);
+				chunk->size = (size_t)file.gcount();
+				if (chunk->size == 0) {
+					pool.push(chunk);
+					break;
+				}
+				result.read += chunk->size;
+				chunk->retain();
+				filled.push(chunk);
+			}
+			filled.close();
+		}));
+
+		//tokenize, a line cut by the end of a chunk is carried into a one off chunk
+		//a carry that reaches the chunk size goes out as a piece of its line, cut after a space
+		//so that no token is split, which keeps a file without line breaks streaming
+		threads.push_back(std::thread([&] {
+			std::string carry;
+			Chunk* chunk;
+
+			//moves the first count bytes of carry into a one off chunk of window
+			auto flush = [&](Window* window, size_t count, bool eol) {
+				Chunk* joined = new Chunk(count, nullptr);
+				std::copy(carry.begin(), carry.begin() + count, joined->data);
+				joined->size = count;
+				window->hold(joined);
+				window->spans.push_back(Span{ joined->data, joined->data + joined->size, eol });
+				carry.erase(0, count);
+			};
+
+			while (filled.pop(chunk)) {
+				Trace::Scope scope("stream", "tokenize");
+				Window* window = new Window();
+				window->hold(chunk);
+
+				const char* c = chunk->data;
+				const char* end = chunk->data + chunk->size;
+				const char* line = c;
+
+				for (; c < end; ++c) {
+					if (*c != '\n') {
+						continue;
+					}
+
+					if (!carry.empty()) {
+						carry.append(line, c);
+						flush(window, carry.size(), true);
+					} else {
+						window->spans.push_back(Span{ line, c, true });
+					}
+					line = c + 1;
+				}
+				carry.append(line, end);
+
+				if (carry.size() >= chunkSize) {
+					size_t cut = carry.find_last_of(" \t");
+					flush(window, cut != std::string::npos ? cut + 1 : carry.size(), false);
+				}
+
+				chunk->release();
+				queues[0]->push(window);
+			}
+
+			if (!carry.empty()) {
+				Window* window = new Window();
+				flush(window, carry.size(), true);
+				queues[0]->push(window);
+			}
+
+			queues[0]->close();
+		}));
+
+		for (size_t i = 0; i < stages.size(); ++i) {
+			threads.push_back(std::thread([&, i] {
+				Window* window;
+				while (queues[i]->pop(window)) {
+					stages[i]->process(*window);
+					queues[i + 1]->push(window);
+				}
+				queues[i + 1]->close();
+			}));
+		}
+
+		//emit
+		Window* window;
+		while (queues.back()->pop(window)) {
+			for (auto& span : window->spans) {
+				out.write(span.start, span.end - span.start);
+				result.written += span.end - span.start;
+				if (span.eol) {
+					out.put('\n');
+					++result.written;
+				}
+			}
+			delete window;
+		}
+
+		for (auto& thread : threads) {
+			thread.join();
+		}
+
+		for (auto queue : queues) {
+			delete queue;
+		}
+		for (auto stage : stages) {
+			delete stage;
+		}
+		for (auto chunk : chunks) {
+			delete chunk;
+		}
+
+		result.ok = !out.fail();
+		return result;
+	} //process
+
+	//streams the file input through the configured stages into out
+	inline Result process(const char* input, std::ostream& out, const Options& options) {
+		std::ifstream file(input, std::ios::binary);
+		if (!file.is_open()) {
+			Result result = { false, 0, 0 };
+			return result;
+		}
+		return process(file, input, out, options);
+	} //process
+} //Stream
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <memory>
+#include <condition_variable>
+
+#include "trace.hpp"
+
+/*
+*	ThreadPool
+*
+*	Fixed set of worker threads running submitted tasks in order of submission.
+*
+*	forEach runs fn(0) .. fn(count - 1) across the workers and the calling thread and
+*	returns when all have finished, so it can be used from inside a task without
+*	starving the pool.
+*/
+class ThreadPool {
+	private:
+		std::mutex lock;
+		std::condition_variable wake;
+		std::deque<std::function<void()>> tasks;
+		std::vector<std::thread> workers;
+		bool stopping;
+
+		void work() {
+			for (;;) {
+				std::function<void()> task;
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					wake.wait(guard, [this] { return stopping || !tasks.empty(); });
+					if (tasks.empty()) {
+						return;
+					}
+					task = std::move(tasks.front());
+					tasks.pop_front();
+				}
+				task();
+			}
+		} //work
+
+		//hide copy
+		ThreadPool(const ThreadPool&);
+		ThreadPool& operator=(const ThreadPool&);
+
+	public:
+		//threads defaults to the number of hardware threads
+		ThreadPool(size_t threads = 0) : stopping(false) {
+			if (threads == 0) {
+				threads = std::thread::hardware_concurrency();
+			}
+			if (threads == 0) {
+				threads = 2;
+			}
+
+			for (size_t i = 0; i < threads; ++i) {
+				workers.push_back(std::thread([this] { work(); }));
+			}
+		}
+
+		//finishes queued tasks, then joins the workers
+		~ThreadPool() {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stopping = true;
+			}
+			wake.notify_all();
+
+			for (auto& worker : workers) {
+				worker.join();
+			}
+		}
+
+		//process wide pool
+		static ThreadPool& shared() {
+			static ThreadPool pool;
+			return pool;
+		} //shared
+
+		size_t size() const { return workers.size(); }
+
+		void submit(std::function<void()> task) {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				tasks.push_back(std::move(task));
+			}
+			wake.notify_one();
+		} //submit
+
+		void forEach(size_t count, const std::function<void(size_t)>& fn) {
+			if (count == 0) {
+				return;
+			}
+
+			struct Shared {
+				std::atomic<size_t> next;
+				std::atomic<size_t> done;
+				std::mutex lock;
+				std::condition_variable finished;
+			};
+			auto shared = std::make_shared<Shared>();
+			shared->next = 0;
+			shared->done = 0;
+
+			auto run = [shared, count, &fn] {
+				for (size_t i = shared->next++; i < count; i = shared->next++) {
+					fn(i);
+					if (++shared->done == count) {
+						std::lock_guard<std::mutex> guard(shared->lock);
+						shared->finished.notify_all();
+					}
+				}
+			};
+
+			size_t helpers = count - 1 < workers.size() ? count - 1 : workers.size();
+			for (size_t i = 0; i < helpers; ++i) {
+				submit(run);
+			}
+			run();
+
+			std::unique_lock<std::mutex> guard(shared->lock);
+			if (shared->done != count) {
+				Trace::Scope scope("wait", "pool tasks");
+				shared->finished.wait(guard, [&] { return shared->done == count; });
+			}
+		} //forEach
+}; //ThreadPool
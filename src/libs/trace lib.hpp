@@ -0,0 +1,43 @@
+#pragma once
+
+#include "luacpp.hpp"
+#include "trace.hpp"
+
+/*
+*	Lua spans for Trace (library "trace")
+*
+*		trace.begin(name [, detail])	opens a span on the calling thread
+*		trace.finish()					closes the innermost span
+*		trace.enabled()					true when the run is being traced
+*/
+class TraceLib {
+	private:
+		static int l_begin(Lua::State* L) {
+			Lua lua(L);
+			Trace::begin("lua", lua.l_checkstring(1), lua.l_optstring(2, nullptr));
+			return 0;
+		} //l_begin
+
+		static int l_finish(Lua::State*) {
+			Trace::finish();
+			return 0;
+		} //l_finish
+
+		static int l_enabled(Lua::State* L) {
+			Lua lua(L);
+			lua.pushboolean(Trace::on());
+			return 1;
+		} //l_enabled
+
+	public:
+		static void attach(Lua& lua) {
+			static const Lua::l_Reg lib[] = {
+				{ "begin", l_begin },
+				{ "finish", l_finish },
+				{ "enabled", l_enabled },
+				{ nullptr, nullptr }
+			};
+			lua.l_register("trace", lib);
+			lua.pop(1);
+		} //attach
+}; //TraceLib
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <stdint.h>
+
+#include "json.hpp"
+
+/*
+*	Trace
+*
+*	Low overhead span recording for Chrome's trace viewer (chrome://tracing, Perfetto).
+*
+*	Each thread records complete events into its own ring buffer, so recording takes no
+*	lock; once a buffer is full the oldest events are overwritten. Timestamps come from
+*	the monotonic clock. Nothing is recorded until Trace::enable is called.
+*
+*		{
+*			Trace::Scope scope("io", "read", filename);
+*			...
+*		}
+*
+*	write() must be called once the recording threads have finished.
+*/
+class Trace {
+	public:
+		struct Event {
+			char name[48];
+			char detail[80];
+			const char* category;
+			int64_t start;		//us
+			int64_t duration;	//us
+		};
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		static const size_t capacity = 1 << 14;
+
+		struct Buffer {
+			uint32_t thread;
+			std::atomic<size_t> head;
+			Event events[capacity];
+
+			//starts of the spans opened with begin
+			std::vector<std::pair<int64_t, Event>> open;
+
+			Buffer(uint32_t thread) : thread(thread), head(0) { }
+		};
+
+		std::atomic<bool> enabled;
+		Clock::time_point created;
+
+		std::mutex lock;
+		std::vector<Buffer*> buffers;
+
+		Trace() : enabled(false), created(Clock::now()) { }
+		~Trace() {
+			for (auto buffer : buffers) {
+				delete buffer;
+			}
+		}
+
+		Buffer& local() {
+			static thread_local Buffer* buffer = nullptr;
+
+			if (buffer == nullptr) {
+				std::lock_guard<std::mutex> guard(lock);
+				buffer = new Buffer((uint32_t)buffers.size() + 1);
+				buffers.push_back(buffer);
+			}
+
+			return *buffer;
+		} //local
+
+		static void copy(char* to, size_t size, const char* from) {
+			if (from == nullptr) {
+				to[0] = 0;
+				return;
+			}
+			strncpy(to, from, size - 1);
+			to[size - 1] = 0;
+		} //copy
+
+		static Event event(const char* category, const char* name, const char* detail) {
+			Event event;
+			event.category = category;
+			copy(event.name, sizeof(event.name), name);
+			copy(event.detail, sizeof(event.detail), detail);
+			return event;
+		} //event
+
+		void record(Event& event, int64_t start) {
+			Buffer& buffer = local();
+			event.start = start;
+			event.duration = now() - start;
+
+			size_t head = buffer.head.load(std::memory_order_relaxed);
+			buffer.events[head % capacity] = event;
+			buffer.head.store(head + 1, std::memory_order_release);
+		} //record
+
+	public:
+		static Trace& instance() {
+			static Trace trace;
+			return trace;
+		} //instance
+
+		static void enable() { instance().enabled = true; }
+		static bool on() { return instance().enabled.load(std::memory_order_relaxed); }
+
+		//us since the tracer was created
+		static int64_t now() {
+			return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - instance().created).count();
+		} //now
+
+		//records a finished span
+		static void span(const char* category, const char* name, const char* detail, int64_t start) {
+			Event e = event(category, name, detail);
+			instance().record(e, start);
+		} //span
+
+		//opens a span on the calling thread, closed by the matching finish
+		static void begin(const char* category, const char* name, const char* detail = nullptr) {
+			if (!on()) {
+				return;
+			}
+			instance().local().open.push_back(std::make_pair(now(), event(category, name, detail)));
+		} //begin
+
+		static void finish() {
+			if (!on()) {
+				return;
+			}
+			Buffer& buffer = instance().local();
+			if (buffer.open.empty()) {
+				return;
+			}
+			auto span = buffer.open.back();
+			buffer.open.pop_back();
+			instance().record(span.second, span.first);
+		} //finish
+
+		class Scope {
+			private:
+				const char* category;
+				const char* name;
+				const char* detail;
+				int64_t start;
+
+			public:
+				Scope(const char* category, const char* name, const char* detail = nullptr) : category(category), name(name), detail(detail), start(-1) {
+					if (on()) {
+						start = now();
+					}
+				}
+
+				~Scope() {
+					if (start != -1) {
+						span(category, name, detail, start);
+					}
+				}
+		}; //Scope
+
+		//writes the recorded events in the Chrome trace event format
+		static bool write(const char* filename) {
+			Trace& trace = instance();
+			std::ofstream out(filename, std::ios::binary);
+			if (!out.is_open()) {
+				return false;
+			}
+
+			std::lock_guard<std::mutex> guard(trace.lock);
+
+			out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+			bool first = true;
+			for (auto buffer : trace.buffers) {
+				out << (first ? "\n" : ",\n");
+				first = false;
+				out << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": " << buffer->thread;
+				out << ", \"args\": {\"name\": \"thread " << buffer->thread << "\"}}";
+
+				size_t head = buffer->head.load(std::memory_order_acquire);
+				for (size_t i = head > capacity ? head - capacity : 0; i < head; ++i) {
+					const Event& event = buffer->events[i % capacity];
+					out << ",\n{\"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->thread;
+					out << ", \"ts\": " << event.start << ", \"dur\": " << event.duration;
+					out << ", \"cat\": ";
+					Json::string(out, event.category != nullptr ? event.category : "");
+					out << ", \"name\": ";
+					Json::string(out, event.name);
+					if (event.detail[0] != 0) {
+						out << ", \"args\": {\"detail\": ";
+						Json::string(out, event.detail);
+						out << "}";
+					}
+					out << "}";
+				}
+			}
+			out << "\n]}\n";
+
+			return true;
+		} //write
+}; //Trace
@@ -1,29 +1,316 @@
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+
 #include "libs\luacpp.hpp"
 #include "libs\luafile.hpp"
 #include "libs\io helper.hpp"
+#include "libs\lua pool.hpp"
+#include "libs\jit report.hpp"
+#include "libs\phase.hpp"
+#include "libs\trace lib.hpp"
+#include "libs\stream lib.hpp"
+#include "libs\luafile lib.hpp"
+#include "libs\mpq lib.hpp"
+#include "libs\object data lib.hpp"
+#include "libs\fs lib.hpp"
+#include "libs\jobs lib.hpp"
+#include "libs\store lib.hpp"
+#include "libs\memo lib.hpp"
+#include "libs\module index lib.hpp"
+#include "libs\jass symbols lib.hpp"
+#include "libs\jass checker lib.hpp"
+#include "libs\jass minifier lib.hpp"
+#include "libs\thread pool.hpp"
+#include "libs\diagnostics lib.hpp"
 
 void report_errors(Lua& lua, int status)
 {
-	
 	if (status != 0) {
-		std::cerr << "-- " << lua.tostring(-1) << std::endl;
+		Diagnostics::error(lua.isstring(-1) ? lua.tostring(-1) : "(error object is not a string)");
 		lua.pop(1); // remove error message
 	}
 }
 
-int main(int argc, char* argv []) {
+//compiles each module to bytecode and writes them as the embedded module table
+int embed_modules(const char* output, int count, char* files [])
+{
 	Lua lua;
+	std::string table;
+
+	ofstream out(output, ios::binary);
+	if (!out.is_open()) {
+		Diagnostics::error(std::string("cannot open ") + output);
+		Diagnostics::shared().close();
+		return 1;
+	}
+
+	out << "#pragma once\n\n// generated by makefile --embed, do not edit\n\n";
+
+	for (int i = 0; i < count; ++i) {
+		std::string code;
+		if (!lua.compile(files[i], code)) {
+			Diagnostics::error(std::string("cannot compile ") + files[i]);
+			Diagnostics::shared().close();
+			return 1;
+		}
+
+		//module name is the path without extension, separators become dots
+		std::string name = files[i];
+		size_t dot = name.find_last_of('.');
+		if (dot != std::string::npos && name.find_first_of("/\\", dot) == std::string::npos) {
+			name.erase(dot);
+		}
+		for (auto& c : name) {
+			if (c == '/' || c == '\\') {
+				c = '.';
+			}
+		}
 
-	lua.l_openlibs();
+		out << "static const unsigned char embedded_module_" << i << "[] = {";
+		for (size_t j = 0; j < code.size(); ++j) {
+			out << (j % 16 == 0 ? "\n\t" : " ") << (int)(unsigned char)code[j] << ",";
+		}
+		out << "\n};\n\n";
 
-	int status = lua.l_loadfile(argv[1]);
-	if (status == 0) {
-		status = lua.pcall(0, LUA_MULTRET, 0);
+		table += "\t{ \"" + name + "\", embedded_module_" + std::to_string(i) + ", sizeof(embedded_module_" + std::to_string(i) + ") },\n";
 	}
-	
-	report_errors(lua, status);
 
-	std::cerr << std::endl;
+	out << "static const EmbeddedModule embedded_modules[] = {\n" << table << "\t{ nullptr, nullptr, 0 }\n};\n";
 
 	return 0;
+}
+
+//registers the native libraries, run once for each state of the pool
+void open_libs(Lua& lua)
+{
+	TraceLib::attach(lua);
+	StreamLib::attach(lua);
+	LuaFileLib::attach(lua);
+	MPQLib::attach(lua);
+	ObjectDataLib::attach(lua);
+	FileSystemLib::attach(lua);
+	JobsLib::attach(lua);
+	StoreLib::attach(lua);
+	MemoLib::attach(lua);
+	ModuleIndexLib::attach(lua);
+	JassSymbolsLib::attach(lua);
+	JassCheckerLib::attach(lua);
+	JassMinifierLib::attach(lua);
+	DiagnosticsLib::attach(lua);
+}
+
+//instruments of one pooled state, they wrap the state and have to outlive the pool
+struct Worker {
+	PhaseLog log;
+	JitReport report;
+};
+
+//a script run, target is set as the global TARGET when given
+struct Variant {
+	const char* script;
+	const char* target;
+};
+
+int main(int argc, char* argv []) {
+	if (argc > 2 && strcmp(argv[1], "--embed") == 0) {
+		return embed_modules(argv[2], argc - 3, argv + 3);
+	}
+
+	if (argc > 2 && strcmp(argv[1], "--compile-symbols") == 0) {
+		std::string error = JassSymbols::build(std::vector<std::string>(argv + 3, argv + argc), argv[2]);
+		if (!error.empty()) {
+			Diagnostics::error(error);
+			Diagnostics::shared().close();
+			return 1;
+		}
+		return 0;
+	}
+
+	bool jit_report = false;
+	const char* jit_policy = nullptr;
+	const char* phases = nullptr;
+	const char* trace = nullptr;
+	const char* batch = nullptr;
+	size_t jobs = 1;
+	std::vector<const char*> args;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--jit-report") == 0) {
+			jit_report = true;
+		} else if (strcmp(argv[i], "--jit-policy") == 0 && i + 1 < argc) {
+			jit_policy = argv[++i];
+		} else if (strcmp(argv[i], "--phases") == 0 && i + 1 < argc) {
+			phases = argv[++i];
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			trace = argv[++i];
+		} else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+			batch = argv[++i];
+		} else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+			int value = atoi(argv[++i]);
+			jobs = value < 1 ? 1 : (size_t)value;
+		} else if (strcmp(argv[i], "--cache-limit") == 0 && i + 1 < argc) {
+			ContentStore::shared().setLimit((size_t)atoi(argv[++i]) << 20);
+		} else if (strcmp(argv[i], "--symbols") == 0 && i + 1 < argc) {
+			if (!JassSymbols::shared().open(argv[++i])) {
+				Diagnostics::error(std::string("cannot open symbol database ") + argv[i]);
+			}
+		} else if (strcmp(argv[i], "--memo-dir") == 0 && i + 1 < argc) {
+			Memo::shared().setDirectory(argv[++i]);
+		} else {
+			args.push_back(argv[i]);
+		}
+	}
+
+	//either several scripts, or one script run for several targets
+	std::vector<Variant> variants;
+	for (auto arg : args) {
+		Variant variant = { batch != nullptr ? batch : arg, batch != nullptr ? arg : nullptr };
+		variants.push_back(variant);
+	}
+
+	if (variants.empty()) {
+		std::cerr << "usage: makefile [options] <script.lua>..." << std::endl;
+		std::cerr << "       makefile [options] --batch <script.lua> <target>..." << std::endl;
+		std::cerr << "       makefile --embed <output.hpp> <module.lua>..." << std::endl;
+		std::cerr << "       makefile --compile-symbols <output.db> common.j Blizzard.j" << std::endl;
+		std::cerr << "options: --jit-report --jit-policy <policy.lua> --phases <out.json> --trace <out.json>" << std::endl;
+		std::cerr << "         --jobs <n> --cache-limit <MB> --memo-dir <dir> --symbols <db>" << std::endl;
+		return 1;
+	}
+
+	if (jobs > variants.size()) {
+		jobs = variants.size();
+	}
+
+	if (trace != nullptr) {
+		Trace::enable();
+	}
+
+	int status = 0;
+
+	JitPolicy policy;
+	if (jit_policy != nullptr) {
+		Lua lua;
+		if (!policy.load(lua, jit_policy)) {
+			report_errors(lua, 1);
+			Diagnostics::shared().close();
+			return 1;
+		}
+	}
+
+	//declared before the pool so that they are destroyed after its states
+	std::mutex workersLock;
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::map<Lua*, Worker*> owners;
+
+	LuaPool pool(1, jobs, [&](Lua& lua) {
+		Worker* worker = new Worker();
+		{
+			std::lock_guard<std::mutex> guard(workersLock);
+			workers.push_back(std::unique_ptr<Worker>(worker));
+			owners[&lua] = worker;
+		}
+
+		if (jit_report && !worker->report.attach(lua)) {
+			Diagnostics::warning("jit report unavailable");
+		}
+
+		worker->log.attach(lua);
+		open_libs(lua);
+
+		if (jit_policy != nullptr) {
+			policy.apply(lua);
+		}
+	});
+
+	std::vector<int> results(variants.size(), 0);
+
+	auto run = [&](size_t i) {
+		const Variant& variant = variants[i];
+		std::string name = variant.target != nullptr ? variant.target : variant.script;
+
+		Lua& lua = *pool.checkout();
+		Worker* worker;
+		{
+			std::lock_guard<std::mutex> guard(workersLock);
+			worker = owners[&lua];
+		}
+
+		if (variant.target != nullptr) {
+			lua.pushstring(variant.target);
+			lua.setglobal("TARGET");
+		}
+
+		int status;
+		{
+			Trace::Scope scope("lua", "load", variant.script);
+			status = lua.l_loadfile(variant.script);
+		}
+		if (status == 0) {
+			Trace::Scope scope("lua", "run", name.c_str());
+			policy.apply(lua, -1, "main");
+			worker->log.begin(lua, name);
+			status = lua.pcall(0, 0, 0);
+			worker->log.finishAll(lua);
+		}
+
+		report_errors(lua, status);
+		results[i] = status;
+
+		pool.checkin(&lua);
+	};
+
+	if (jobs > 1) {
+		//the calling thread takes part in forEach
+		ThreadPool runners(jobs - 1);
+		runners.forEach(variants.size(), run);
+	} else {
+		for (size_t i = 0; i < variants.size(); ++i) {
+			run(i);
+		}
+	}
+
+	for (size_t i = 0; i < variants.size(); ++i) {
+		if (results[i] != 0) {
+			status = 1;
+			if (variants.size() > 1) {
+				Diagnostics::error(std::string("failed ") + (variants[i].target != nullptr ? variants[i].target : variants[i].script));
+			}
+		}
+	}
+
+	if (jit_report) {
+		//the report goes to stderr as well, after the diagnostics of the run
+		Diagnostics::shared().flush();
+		for (auto& worker : workers) {
+			worker->report.print(std::cerr);
+		}
+	}
+
+	if (phases != nullptr) {
+		ofstream out(phases, ios::binary);
+		if (workers.size() == 1) {
+			workers[0]->log.json(out);
+		} else {
+			out << "[";
+			for (size_t i = 0; i < workers.size(); ++i) {
+				out << (i > 0 ? "," : "");
+				workers[i]->log.json(out);
+			}
+			out << "]";
+		}
+	}
+
+	if (trace != nullptr && !Trace::write(trace)) {
+		Diagnostics::error(std::string("cannot write ") + trace);
+	}
+
+	Diagnostics::shared().close();
+
+	return status;
 }
\ No newline at end of file